@@ -0,0 +1,536 @@
+#include "import.h"
+#include "statement.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+enum {
+    BENCH_DEFAULT_ROWS = 100000,
+    BENCH_DEFAULT_LOOKUPS = 100000,
+    BENCH_DEFAULT_SCANS = 5,
+    BENCH_DEFAULT_OPENS = 20,
+    BENCH_DEFAULT_CRASHES = 5,
+    BENCH_DEFAULT_WIDE_ROWS = 2000000,
+    BENCH_STATEMENT_SIZE = 128,
+    BENCH_WIDE_STATEMENTS = 20,
+    BENCH_FULL_MAX_PAGES = 256,
+    BENCH_FULL_IMPORT_ROWS = 100000, // * More than BENCH_FULL_MAX_PAGES pages hold
+    BENCH_WIDE_STATEMENT_SIZE = 64 * INSERT_MAX_ROWS + BENCH_STATEMENT_SIZE
+};
+
+typedef struct {
+    DBOptions Options;
+    const char* Filename;
+    uint32_t Rows;
+    uint32_t Lookups;
+    uint32_t Scans;
+    uint32_t Opens;
+    uint32_t Crashes;
+    uint32_t WideRows;
+    uint64_t Seed;
+} BenchConfig;
+
+// * Latencies of every operation of one workload, in nanoseconds. Setup
+// * between operations, such as closing the database, is not counted.
+typedef struct {
+    const char* Workload;
+    uint64_t* Latencies;
+    uint32_t NumOps;
+} BenchRun;
+
+uint64_t NowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// * xorshift64*, so runs with the same seed insert and look up the same IDs
+uint64_t NextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+void BeginRun(BenchRun* run, const char* workload, uint32_t maxOps) {
+    run->Workload = workload;
+    run->Latencies = malloc(sizeof(uint64_t) * (maxOps > 0 ? maxOps : 1));
+    run->NumOps = 0;
+}
+
+void RecordOp(BenchRun* run, uint64_t startedAt) {
+    run->Latencies[run->NumOps++] = NowNs() - startedAt;
+}
+
+int CompareLatencies(const void* left, const void* right) {
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a > b) - (a < b);
+}
+
+double Percentile(BenchRun* run, uint32_t percent) {
+    if (run->NumOps == 0) {
+        return 0;
+    }
+    return run->Latencies[(uint64_t)(run->NumOps - 1) * percent / 100] / 1000.0;
+}
+
+// * One JSON object per line. Workloads that process many rows per operation
+// * pass the row count so rows_per_sec can be reported beside ops_per_sec.
+void EndRun(BenchRun* run, uint64_t rowsProcessed) {
+    uint64_t totalNs = 0;
+    for (uint32_t i = 0; i < run->NumOps; i++) {
+        totalNs += run->Latencies[i];
+    }
+    double seconds = totalNs / 1e9;
+    qsort(run->Latencies, run->NumOps, sizeof(uint64_t), CompareLatencies);
+
+    printf("{\"workload\": \"%s\", \"ops\": %u, \"seconds\": %.6f, \"ops_per_sec\": %.1f, \"p50_us\": %.2f, \"p99_us\": %.2f",
+           run->Workload, run->NumOps, seconds, run->NumOps / seconds, Percentile(run, 50), Percentile(run, 99));
+    if (rowsProcessed > 0) {
+        printf(", \"rows_per_sec\": %.1f", rowsProcessed / seconds);
+    }
+    printf("}\n");
+    fflush(stdout);
+    free(run->Latencies);
+}
+
+// * Runs one statement through the same prepare and execute path as the shell
+EExecuteResult RunStatement(Table* table, char* text) {
+    InputBuffer inputBuffer;
+    inputBuffer.Buffer = text;
+    inputBuffer.InputLength = strlen(text);
+    inputBuffer.BufferLength = inputBuffer.InputLength + 1;
+
+    Statement statement;
+    if (PrepareStatement(&inputBuffer, &statement) != PREPARE_SUCCESS) {
+        printf("Benchmark statement did not parse: %s\n", text);
+        exit(EXIT_FAILURE);
+    }
+    return ExecuteStatement(&statement, table, table->Output);
+}
+
+void RemoveDatabase(const char* filename) {
+    char walFilename[PATH_MAX];
+    snprintf(walFilename, sizeof(walFilename), "%s-wal", filename);
+    unlink(filename);
+    unlink(walFilename);
+}
+
+// * Opens the database with select output discarded
+Table* OpenBenchDB(BenchConfig* config) {
+    Table* table = OpenDB(config->Filename, &config->Options);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull == -1) {
+        printf("Unable to open /dev/null.\n");
+        exit(EXIT_FAILURE);
+    }
+    SinkRedirect(table->Output, devNull, true);
+    return table;
+}
+
+// * IDs 1..Rows, shuffled unless sequential
+uint32_t* BenchIdentifiers(BenchConfig* config, bool sequential) {
+    uint32_t* identifiers = malloc(sizeof(uint32_t) * config->Rows);
+    for (uint32_t i = 0; i < config->Rows; i++) {
+        identifiers[i] = i + 1;
+    }
+    if (!sequential) {
+        uint64_t state = config->Seed;
+        for (uint32_t i = config->Rows; i > 1; i--) {
+            uint32_t j = NextRandom(&state) % i;
+            uint32_t swap = identifiers[i - 1];
+            identifiers[i - 1] = identifiers[j];
+            identifiers[j] = swap;
+        }
+    }
+    return identifiers;
+}
+
+// * Inserts the given IDs into a fresh database and leaves it open
+Table* BenchInsert(BenchConfig* config, const char* workload, uint32_t* identifiers, uint32_t count) {
+    RemoveDatabase(config->Filename);
+    Table* table = OpenBenchDB(config);
+
+    BenchRun run;
+    BeginRun(&run, workload, count);
+    char text[BENCH_STATEMENT_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        snprintf(text, sizeof(text), "insert %u user%u person%u@example.com", identifiers[i], identifiers[i], identifiers[i]);
+        uint64_t startedAt = NowNs();
+        if (RunStatement(table, text) != EXECUTE_SUCCESS) {
+            printf("Insert of %u failed.\n", identifiers[i]);
+            exit(EXIT_FAILURE);
+        }
+        RecordOp(&run, startedAt);
+    }
+    EndRun(&run, 0);
+    return table;
+}
+
+void BenchFullScan(BenchConfig* config, Table* table) {
+    BenchRun run;
+    BeginRun(&run, "full_scan", config->Scans);
+    char text[BENCH_STATEMENT_SIZE];
+    for (uint32_t i = 0; i < config->Scans; i++) {
+        strcpy(text, "select");
+        uint64_t startedAt = NowNs();
+        RunStatement(table, text);
+        RecordOp(&run, startedAt);
+    }
+    EndRun(&run, (uint64_t)config->Rows * config->Scans);
+}
+
+void BenchPointLookup(BenchConfig* config, Table* table) {
+    BenchRun run;
+    BeginRun(&run, "point_lookup", config->Lookups);
+    uint64_t state = config->Seed;
+    char text[BENCH_STATEMENT_SIZE];
+    for (uint32_t i = 0; i < config->Lookups; i++) {
+        snprintf(text, sizeof(text), "select where id = %u", (uint32_t)(NextRandom(&state) % config->Rows) + 1);
+        uint64_t startedAt = NowNs();
+        RunStatement(table, text);
+        RecordOp(&run, startedAt);
+    }
+    EndRun(&run, 0);
+}
+
+// * Time to open the database and answer its first point lookup. A cold open
+// * first drops the file from the page cache; the database is closed cleanly,
+// * so every page is already on disk.
+void BenchOpen(BenchConfig* config, const char* workload, bool cold) {
+    BenchRun run;
+    BeginRun(&run, workload, config->Opens);
+    uint64_t state = config->Seed;
+    char text[BENCH_STATEMENT_SIZE];
+    for (uint32_t i = 0; i < config->Opens; i++) {
+        if (cold) {
+            int fileDescriptor = open(config->Filename, O_RDONLY);
+            posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+            close(fileDescriptor);
+        }
+        snprintf(text, sizeof(text), "select where id = %u", (uint32_t)(NextRandom(&state) % config->Rows) + 1);
+
+        uint64_t startedAt = NowNs();
+        Table* table = OpenBenchDB(config);
+        RunStatement(table, text);
+        RecordOp(&run, startedAt);
+        CloseDB(table);
+    }
+    EndRun(&run, 0);
+}
+
+// * A full scan of a database just opened with the file dropped from the
+// * page cache, so every leaf is a miss unless read-ahead got to it first
+void BenchColdScan(BenchConfig* config) {
+    BenchRun run;
+    BeginRun(&run, "full_scan_cold", config->Scans);
+    char text[BENCH_STATEMENT_SIZE];
+    for (uint32_t i = 0; i < config->Scans; i++) {
+        int fileDescriptor = open(config->Filename, O_RDONLY);
+        posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+        close(fileDescriptor);
+        Table* table = OpenBenchDB(config);
+        strcpy(text, "select");
+
+        uint64_t startedAt = NowNs();
+        RunStatement(table, text);
+        RecordOp(&run, startedAt);
+        CloseDB(table);
+    }
+    EndRun(&run, (uint64_t)config->Rows * config->Scans);
+}
+
+// * A child process inserts a tenth of the rows and exits without closing,
+// * leaving them in the write-ahead log. Times the open that recovers them.
+void BenchCrashReopen(BenchConfig* config) {
+    uint32_t count = config->Rows / 10 > 0 ? config->Rows / 10 : 1;
+    uint32_t* identifiers = BenchIdentifiers(config, false);
+
+    BenchRun run;
+    BeginRun(&run, "crash_reopen", config->Crashes);
+    for (uint32_t i = 0; i < config->Crashes; i++) {
+        RemoveDatabase(config->Filename);
+        pid_t child = fork();
+        if (child == 0) {
+            Table* table = OpenBenchDB(config);
+            char text[BENCH_STATEMENT_SIZE];
+            for (uint32_t j = 0; j < count; j++) {
+                snprintf(text, sizeof(text), "insert %u user%u person%u@example.com", identifiers[j], identifiers[j], identifiers[j]);
+                RunStatement(table, text);
+            }
+            _exit(EXIT_SUCCESS);
+        }
+        int status;
+        waitpid(child, &status, 0);
+
+        uint64_t startedAt = NowNs();
+        Table* table = OpenBenchDB(config);
+        RecordOp(&run, startedAt);
+        CloseDB(table);
+    }
+    EndRun(&run, 0);
+    free(identifiers);
+}
+
+// * Writes an `insert values` of count rows with IDs first, first + stride, ...
+void FormatWideInsert(char* text, uint32_t first, uint32_t stride, uint32_t count) {
+    size_t length = sprintf(text, "insert values");
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t identifier = first + i * stride;
+        length += sprintf(text + length, "%s (%u, user%u, person%u@example.com)", i == 0 ? "" : ",", identifier, identifier, identifier);
+    }
+}
+
+// * Bulk loads even IDs 2..2 * numRows through .import, which packs every
+// * leaf and internal node, with the import's summary line kept off stdout
+void ImportEvenRows(Table* table, const char* filename, uint32_t numRows) {
+    char csvFilename[PATH_MAX];
+    snprintf(csvFilename, sizeof(csvFilename), "%s.csv", filename);
+    FILE* csv = fopen(csvFilename, "w");
+    if (csv == NULL) {
+        printf("Unable to create '%s'.\n", csvFilename);
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 1; i <= numRows; i++) {
+        fprintf(csv, "%u,user%u,person%u@example.com\n", 2 * i, 2 * i, 2 * i);
+    }
+    fclose(csv);
+
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (savedStdout == -1 || devNull == -1) {
+        printf("Unable to redirect stdout.\n");
+        exit(EXIT_FAILURE);
+    }
+    dup2(devNull, STDOUT_FILENO);
+    ImportCSV(table, csvFilename);
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    close(devNull);
+    unlink(csvFilename);
+}
+
+// * Multi-row inserts into a bulk-loaded table with both indexes, each row
+// * landing in a different full leaf, so one statement dirties more pages
+// * than a single writev can take: the leaves, their split siblings, their
+// * parents and both index chains. Every statement has to commit whole.
+void BenchWideInsert(BenchConfig* config) {
+    RemoveDatabase(config->Filename);
+    Table* table = OpenBenchDB(config);
+    uint32_t numRows = config->WideRows;
+    ImportEvenRows(table, config->Filename, numRows);
+    uint64_t numImported = __atomic_load_n(&table->NumRows, __ATOMIC_RELAXED);
+    if (numImported != numRows) {
+        printf("Import loaded %llu of %u rows.\n", (unsigned long long)numImported, numRows);
+        exit(EXIT_FAILURE);
+    }
+    char* text = malloc(BENCH_WIDE_STATEMENT_SIZE);
+    strcpy(text, "create index on username");
+    RunStatement(table, text);
+    strcpy(text, "create index on email");
+    RunStatement(table, text);
+
+    // * Odd IDs spread over the whole key range, each statement's set offset
+    // * far enough from the last that it splits leaves of its own
+    uint32_t perStatement = numRows < INSERT_MAX_ROWS ? numRows : INSERT_MAX_ROWS;
+    uint32_t stride = numRows / perStatement;
+    uint32_t numStatements = stride < BENCH_WIDE_STATEMENTS ? stride : BENCH_WIDE_STATEMENTS;
+    uint32_t offsetStep = stride / numStatements;
+    BenchRun run;
+    BeginRun(&run, "wide_insert", numStatements);
+    for (uint32_t i = 0; i < numStatements; i++) {
+        FormatWideInsert(text, 2 * i * offsetStep + 1, 2 * stride, perStatement);
+        uint64_t startedAt = NowNs();
+        if (RunStatement(table, text) != EXECUTE_SUCCESS) {
+            printf("Wide insert %u failed.\n", i + 1);
+            exit(EXIT_FAILURE);
+        }
+        RecordOp(&run, startedAt);
+    }
+    EndRun(&run, (uint64_t)numStatements * perStatement);
+
+    free(text);
+    CloseDB(table);
+}
+
+// * Fails unless the table stayed within its page limit and reopens with
+// * the rows it reported
+void CheckFullTable(BenchConfig* config, Table* table, uint64_t numRows) {
+    uint32_t numPages = GetUnusedPageNum(table->Pager);
+    CloseDB(table);
+    if (numPages > config->Options.MaxPages) {
+        printf("Table grew to %u pages past its limit of %u.\n", numPages, config->Options.MaxPages);
+        exit(EXIT_FAILURE);
+    }
+    table = OpenBenchDB(config);
+    uint64_t numReopened = __atomic_load_n(&table->NumRows, __ATOMIC_RELAXED);
+    CloseDB(table);
+    if (numReopened != numRows) {
+        printf("Full table reopened with %llu of its %llu rows.\n", (unsigned long long)numReopened, (unsigned long long)numRows);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// * Single-row inserts of random IDs into a table capped at
+// * BENCH_FULL_MAX_PAGES until one reports it full, then an import into a
+// * fresh capped table that has to stop at the limit too
+void BenchTableFull(BenchConfig* config) {
+    BenchConfig fullConfig = *config;
+    fullConfig.Options.MaxPages = BENCH_FULL_MAX_PAGES;
+    RemoveDatabase(fullConfig.Filename);
+    Table* table = OpenBenchDB(&fullConfig);
+
+    uint32_t maxRows = BENCH_FULL_MAX_PAGES * LEAF_NODE_MAX_CELLS;
+    BenchRun run;
+    BeginRun(&run, "table_full", maxRows);
+    uint64_t state = config->Seed;
+    uint32_t numInserted = 0;
+    char text[BENCH_STATEMENT_SIZE];
+    EExecuteResult result = EXECUTE_SUCCESS;
+    while (result != EXECUTE_TABLE_FULL) {
+        uint32_t identifier = (uint32_t)(NextRandom(&state) % UINT32_MAX) + 1;
+        snprintf(text, sizeof(text), "insert %u user%u person%u@example.com", identifier, identifier, identifier);
+        uint64_t startedAt = NowNs();
+        result = RunStatement(table, text);
+        if (result == EXECUTE_SUCCESS && numInserted == maxRows) {
+            printf("Table capped at %d pages took %u rows without filling up.\n", BENCH_FULL_MAX_PAGES, numInserted);
+            exit(EXIT_FAILURE);
+        } else if (result == EXECUTE_SUCCESS) {
+            RecordOp(&run, startedAt);
+            numInserted++;
+        } else if (result != EXECUTE_DUPLICATE_KEY && result != EXECUTE_TABLE_FULL) {
+            printf("Insert of %u failed.\n", identifier);
+            exit(EXIT_FAILURE);
+        }
+    }
+    EndRun(&run, 0);
+    CheckFullTable(&fullConfig, table, numInserted);
+
+    RemoveDatabase(fullConfig.Filename);
+    table = OpenBenchDB(&fullConfig);
+    ImportEvenRows(table, fullConfig.Filename, BENCH_FULL_IMPORT_ROWS);
+    uint64_t numImported = __atomic_load_n(&table->NumRows, __ATOMIC_RELAXED);
+    if (numImported == 0 || numImported >= BENCH_FULL_IMPORT_ROWS) {
+        printf("Import into a full table loaded %llu rows.\n", (unsigned long long)numImported);
+        exit(EXIT_FAILURE);
+    }
+    CheckFullTable(&fullConfig, table, numImported);
+}
+
+void PrintUsage(char const* program) {
+    printf("Usage: %s [options] [database file]\n", program);
+    printf("  --rows N       rows inserted by the insert workloads (default %d)\n", BENCH_DEFAULT_ROWS);
+    printf("  --lookups N    point lookups (default %d)\n", BENCH_DEFAULT_LOOKUPS);
+    printf("  --scans N      full scans (default %d)\n", BENCH_DEFAULT_SCANS);
+    printf("  --opens N      cold and warm opens (default %d)\n", BENCH_DEFAULT_OPENS);
+    printf("  --crashes N    crash and reopen cycles (default %d)\n", BENCH_DEFAULT_CRASHES);
+    printf("  --wide-rows N  rows in the table the wide inserts go into (default %d)\n", BENCH_DEFAULT_WIDE_ROWS);
+    printf("  --seed N       seed for random IDs (default 1)\n");
+    printf("  --frames N     buffer pool size in pages (default %d)\n", POOL_DEFAULT_FRAMES);
+    printf("  --read-ahead N    pages read ahead of sequential misses, 0 to turn off (default %d)\n", READAHEAD_DEFAULT_PAGES);
+    printf("  --scan-threads N  threads each full scan may use (default one per online CPU)\n");
+    printf("  --mmap         serve pages from a memory map of the file\n");
+    printf("Prints one JSON object per workload. The database file defaults to db-bench.db and is deleted at the end.\n");
+}
+
+uint32_t ParseOptionValue(char const* name, char const* value, long minimum) {
+    char* end = NULL;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < minimum || parsed > UINT32_MAX / 2) {
+        printf("Invalid value '%s' for %s.\n", value, name);
+        exit(EXIT_FAILURE);
+    }
+    return (uint32_t)parsed;
+}
+
+int main(int argc, char const* argv[]) {
+    BenchConfig config;
+    config.Options.PoolFrames = POOL_DEFAULT_FRAMES;
+    config.Options.CommitBatch = WAL_DEFAULT_COMMIT_BATCH;
+    config.Options.CommitIntervalMs = WAL_DEFAULT_COMMIT_INTERVAL_MS;
+    config.Options.CheckpointMB = WAL_DEFAULT_CHECKPOINT_MB;
+    config.Options.UseMmap = false;
+    config.Options.StatsPath = NULL;
+    config.Options.ScanThreads = 0;
+    config.Options.ReadAheadPages = READAHEAD_DEFAULT_PAGES;
+    config.Options.FlushRateMB = FLUSHER_DEFAULT_RATE_MB;
+    config.Options.MaxPages = 0;
+    config.Filename = "db-bench.db";
+    config.Rows = BENCH_DEFAULT_ROWS;
+    config.Lookups = BENCH_DEFAULT_LOOKUPS;
+    config.Scans = BENCH_DEFAULT_SCANS;
+    config.Opens = BENCH_DEFAULT_OPENS;
+    config.Crashes = BENCH_DEFAULT_CRASHES;
+    config.WideRows = BENCH_DEFAULT_WIDE_ROWS;
+    config.Seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            config.Rows = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--lookups") == 0 && i + 1 < argc) {
+            config.Lookups = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--scans") == 0 && i + 1 < argc) {
+            config.Scans = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--opens") == 0 && i + 1 < argc) {
+            config.Opens = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--crashes") == 0 && i + 1 < argc) {
+            config.Crashes = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--wide-rows") == 0 && i + 1 < argc) {
+            config.WideRows = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.Seed = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            config.Options.PoolFrames = ParseOptionValue(argv[i], argv[i + 1], POOL_MIN_FRAMES);
+            i++;
+        } else if (strcmp(argv[i], "--read-ahead") == 0 && i + 1 < argc) {
+            config.Options.ReadAheadPages = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--scan-threads") == 0 && i + 1 < argc) {
+            config.Options.ScanThreads = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            config.Options.UseMmap = true;
+        } else if (argv[i][0] == '-') {
+            PrintUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        } else {
+            config.Filename = argv[i];
+        }
+    }
+
+    uint32_t* identifiers = BenchIdentifiers(&config, true);
+    Table* table = BenchInsert(&config, "sequential_insert", identifiers, config.Rows);
+    free(identifiers);
+    BenchFullScan(&config, table);
+    BenchPointLookup(&config, table);
+    CloseDB(table);
+
+    BenchOpen(&config, "open_warm", false);
+    BenchOpen(&config, "open_cold", true);
+    BenchColdScan(&config);
+
+    identifiers = BenchIdentifiers(&config, false);
+    table = BenchInsert(&config, "random_insert", identifiers, config.Rows);
+    free(identifiers);
+    CloseDB(table);
+
+    BenchCrashReopen(&config);
+    BenchWideInsert(&config);
+    BenchTableFull(&config);
+    RemoveDatabase(config.Filename);
+    return 0;
+}
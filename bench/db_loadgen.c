@@ -0,0 +1,342 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+enum {
+    LOADGEN_MAX_STEPS = 16,
+    LOADGEN_DEFAULT_SECONDS = 5,
+    LOADGEN_DEFAULT_ROWS = 20000,
+    LOADGEN_DEFAULT_INSERT_PERCENT = 20,
+    LOADGEN_DEFAULT_SCAN_PERCENT = 20,
+    LOADGEN_STATEMENT_SIZE = 128,
+    LOADGEN_RESPONSE_SIZE = 4096
+};
+
+// * Each step runs ThreadCounts[i] clients for Seconds. A client picks an
+// * insert, a full scan or a point lookup for every statement, by percentage.
+typedef struct {
+    const char* SocketPath;
+    uint32_t ThreadCounts[LOADGEN_MAX_STEPS];
+    uint32_t NumSteps;
+    uint32_t Seconds;
+    uint32_t Rows;
+    uint32_t InsertPercent;
+    uint32_t ScanPercent;
+    uint64_t Seed;
+} LoadConfig;
+
+typedef struct {
+    int FileDescriptor;
+    char* Response;
+    size_t ResponseLength;
+    size_t ResponseCapacity;
+} Connection;
+
+// * Latencies in nanoseconds of every statement one client ran in a step
+typedef struct {
+    LoadConfig* Config;
+    pthread_t Thread;
+    uint64_t Seed;
+    uint64_t Deadline;
+    uint64_t* Latencies;
+    uint32_t NumOps;
+    uint32_t LatenciesCapacity;
+    uint64_t Inserts;
+    uint64_t Scans;
+    uint64_t Lookups;
+    uint64_t Errors;
+} LoadClient;
+
+// * Highest ID inserted so far; lookups pick IDs at or below it
+uint32_t MaxIdentifier;
+
+uint64_t NowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// * xorshift64*
+uint64_t NextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+bool ResponseComplete(Connection* connection) {
+    return connection->ResponseLength >= 5 && memcmp(connection->Response + connection->ResponseLength - 5, "db > ", 5) == 0;
+}
+
+// * Reads until the server's next prompt, which ends every response
+void ReadResponse(Connection* connection) {
+    connection->ResponseLength = 0;
+    while (!ResponseComplete(connection)) {
+        if (connection->ResponseLength == connection->ResponseCapacity) {
+            connection->ResponseCapacity *= 2;
+            connection->Response = realloc(connection->Response, connection->ResponseCapacity);
+        }
+        ssize_t bytesRead = read(connection->FileDescriptor, connection->Response + connection->ResponseLength,
+                                 connection->ResponseCapacity - connection->ResponseLength);
+        if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            printf("Server closed the connection.\n");
+            exit(EXIT_FAILURE);
+        }
+        connection->ResponseLength += bytesRead;
+    }
+}
+
+Connection* Connect(const char* socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+    Connection* connection = malloc(sizeof(Connection));
+    connection->FileDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection->FileDescriptor == -1 || connect(connection->FileDescriptor, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        printf("Unable to connect to '%s': %d\n", socketPath, errno);
+        exit(EXIT_FAILURE);
+    }
+    connection->ResponseCapacity = LOADGEN_RESPONSE_SIZE;
+    connection->Response = malloc(connection->ResponseCapacity);
+    ReadResponse(connection);
+    return connection;
+}
+
+void Disconnect(Connection* connection) {
+    close(connection->FileDescriptor);
+    free(connection->Response);
+    free(connection);
+}
+
+// * Sends one statement and waits for its whole response. Returns false if
+// * the server reported an error.
+bool Request(Connection* connection, const char* statement) {
+    char line[LOADGEN_STATEMENT_SIZE];
+    int length = snprintf(line, sizeof(line), "%s\n", statement);
+    for (int written = 0; written < length;) {
+        ssize_t bytesWritten = write(connection->FileDescriptor, line + written, length - written);
+        if (bytesWritten == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesWritten == -1) {
+            printf("Error sending statement: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        written += bytesWritten;
+    }
+    ReadResponse(connection);
+    connection->Response[connection->ResponseLength - 5] = '\0';
+    return strstr(connection->Response, "Executed.\n") != NULL;
+}
+
+// * Inserts IDs up to Rows unless the table already holds more, and returns
+// * the highest ID in the table.
+uint32_t Prepare(LoadConfig* config) {
+    Connection* connection = Connect(config->SocketPath);
+    if (!Request(connection, "select max(id)")) {
+        printf("Unexpected response: %s\n", connection->Response);
+        exit(EXIT_FAILURE);
+    }
+    uint32_t maxIdentifier = (uint32_t)strtoul(connection->Response, NULL, 10);
+
+    char statement[LOADGEN_STATEMENT_SIZE];
+    for (uint32_t i = maxIdentifier + 1; i <= config->Rows; i++) {
+        snprintf(statement, sizeof(statement), "insert %u user%u person%u@example.com", i, i, i);
+        Request(connection, statement);
+    }
+    Disconnect(connection);
+    return maxIdentifier > config->Rows ? maxIdentifier : config->Rows;
+}
+
+void RecordOp(LoadClient* client, uint64_t startedAt) {
+    if (client->NumOps == client->LatenciesCapacity) {
+        client->LatenciesCapacity *= 2;
+        client->Latencies = realloc(client->Latencies, client->LatenciesCapacity * sizeof(uint64_t));
+    }
+    client->Latencies[client->NumOps++] = NowNs() - startedAt;
+}
+
+void* RunClient(void* argument) {
+    LoadClient* client = argument;
+    LoadConfig* config = client->Config;
+    Connection* connection = Connect(config->SocketPath);
+    char statement[LOADGEN_STATEMENT_SIZE];
+
+    while (NowNs() < client->Deadline) {
+        uint32_t choice = NextRandom(&client->Seed) % 100;
+        if (choice < config->InsertPercent) {
+            uint32_t identifier = __atomic_add_fetch(&MaxIdentifier, 1, __ATOMIC_RELAXED);
+            snprintf(statement, sizeof(statement), "insert %u user%u person%u@example.com", identifier, identifier, identifier);
+            client->Inserts += 1;
+        } else if (choice < config->InsertPercent + config->ScanPercent) {
+            // * Reads every row without sending them back
+            snprintf(statement, sizeof(statement), "select count(*) where email like '%%@example.com'");
+            client->Scans += 1;
+        } else {
+            uint32_t maxIdentifier = __atomic_load_n(&MaxIdentifier, __ATOMIC_RELAXED);
+            uint32_t identifier = 1 + NextRandom(&client->Seed) % maxIdentifier;
+            snprintf(statement, sizeof(statement), "select where id = %u", identifier);
+            client->Lookups += 1;
+        }
+
+        uint64_t startedAt = NowNs();
+        if (!Request(connection, statement)) {
+            client->Errors += 1;
+        }
+        RecordOp(client, startedAt);
+    }
+
+    Disconnect(connection);
+    return NULL;
+}
+
+int CompareLatencies(const void* left, const void* right) {
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a > b) - (a < b);
+}
+
+// * Runs one step and prints it as one JSON object per line
+void RunStep(LoadConfig* config, uint32_t numThreads) {
+    LoadClient* clients = calloc(numThreads, sizeof(LoadClient));
+    uint64_t startedAt = NowNs();
+    uint64_t deadline = startedAt + (uint64_t)config->Seconds * 1000000000;
+
+    for (uint32_t i = 0; i < numThreads; i++) {
+        clients[i].Config = config;
+        clients[i].Seed = config->Seed + i * 7919 + numThreads;
+        clients[i].Deadline = deadline;
+        clients[i].LatenciesCapacity = 1024;
+        clients[i].Latencies = malloc(clients[i].LatenciesCapacity * sizeof(uint64_t));
+        if (pthread_create(&clients[i].Thread, NULL, RunClient, &clients[i]) != 0) {
+            printf("Unable to start client %d.\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t totalOps = 0, inserts = 0, scans = 0, lookups = 0, errors = 0;
+    for (uint32_t i = 0; i < numThreads; i++) {
+        pthread_join(clients[i].Thread, NULL);
+        totalOps += clients[i].NumOps;
+        inserts += clients[i].Inserts;
+        scans += clients[i].Scans;
+        lookups += clients[i].Lookups;
+        errors += clients[i].Errors;
+    }
+    double seconds = (NowNs() - startedAt) / 1e9;
+
+    uint64_t* latencies = malloc((totalOps > 0 ? totalOps : 1) * sizeof(uint64_t));
+    uint64_t numLatencies = 0;
+    for (uint32_t i = 0; i < numThreads; i++) {
+        memcpy(latencies + numLatencies, clients[i].Latencies, clients[i].NumOps * sizeof(uint64_t));
+        numLatencies += clients[i].NumOps;
+        free(clients[i].Latencies);
+    }
+    qsort(latencies, numLatencies, sizeof(uint64_t), CompareLatencies);
+    double p50 = numLatencies > 0 ? latencies[(numLatencies - 1) * 50 / 100] / 1000.0 : 0;
+    double p99 = numLatencies > 0 ? latencies[(numLatencies - 1) * 99 / 100] / 1000.0 : 0;
+
+    printf("{\"threads\": %u, \"ops\": %llu, \"seconds\": %.3f, \"ops_per_sec\": %.1f, \"inserts_per_sec\": %.1f, "
+           "\"scans_per_sec\": %.1f, \"lookups_per_sec\": %.1f, \"errors\": %llu, \"p50_us\": %.2f, \"p99_us\": %.2f}\n",
+           numThreads, (unsigned long long)totalOps, seconds, totalOps / seconds, inserts / seconds,
+           scans / seconds, lookups / seconds, (unsigned long long)errors, p50, p99);
+    fflush(stdout);
+    free(latencies);
+    free(clients);
+}
+
+void PrintUsage(char const* program) {
+    printf("Usage: %s [options] <server socket>\n", program);
+    printf("  --threads LIST    comma separated client counts, one step each (default 1,2,4,8)\n");
+    printf("  --seconds N       length of each step (default %d)\n", LOADGEN_DEFAULT_SECONDS);
+    printf("  --rows N          rows inserted before the first step (default %d)\n", LOADGEN_DEFAULT_ROWS);
+    printf("  --inserts PCT     share of statements that insert (default %d)\n", LOADGEN_DEFAULT_INSERT_PERCENT);
+    printf("  --scans PCT       share of statements that scan the whole table (default %d)\n", LOADGEN_DEFAULT_SCAN_PERCENT);
+    printf("  --seed N          seed for the statement mix and lookup IDs (default 1)\n");
+    printf("The remaining statements are point lookups.\n");
+}
+
+uint32_t ParseOptionValue(char const* name, char const* value, long minimum, long maximum) {
+    char* end = NULL;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < minimum || parsed > maximum) {
+        printf("Invalid value '%s' for %s.\n", value, name);
+        exit(EXIT_FAILURE);
+    }
+    return (uint32_t)parsed;
+}
+
+void ParseThreadCounts(LoadConfig* config, char const* list) {
+    char* copy = strdup(list);
+    char* save = NULL;
+    config->NumSteps = 0;
+    for (char* count = strtok_r(copy, ",", &save); count != NULL; count = strtok_r(NULL, ",", &save)) {
+        if (config->NumSteps == LOADGEN_MAX_STEPS) {
+            printf("At most %d thread counts.\n", LOADGEN_MAX_STEPS);
+            exit(EXIT_FAILURE);
+        }
+        config->ThreadCounts[config->NumSteps++] = ParseOptionValue("--threads", count, 1, 4096);
+    }
+    free(copy);
+}
+
+int main(int argc, char const* argv[]) {
+    LoadConfig config;
+    config.SocketPath = NULL;
+    config.Seconds = LOADGEN_DEFAULT_SECONDS;
+    config.Rows = LOADGEN_DEFAULT_ROWS;
+    config.InsertPercent = LOADGEN_DEFAULT_INSERT_PERCENT;
+    config.ScanPercent = LOADGEN_DEFAULT_SCAN_PERCENT;
+    config.Seed = 1;
+    ParseThreadCounts(&config, "1,2,4,8");
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            ParseThreadCounts(&config, argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            config.Seconds = ParseOptionValue(argv[i], argv[i + 1], 1, 3600);
+            i++;
+        } else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            config.Rows = ParseOptionValue(argv[i], argv[i + 1], 1, UINT32_MAX / 2);
+            i++;
+        } else if (strcmp(argv[i], "--inserts") == 0 && i + 1 < argc) {
+            config.InsertPercent = ParseOptionValue(argv[i], argv[i + 1], 0, 100);
+            i++;
+        } else if (strcmp(argv[i], "--scans") == 0 && i + 1 < argc) {
+            config.ScanPercent = ParseOptionValue(argv[i], argv[i + 1], 0, 100);
+            i++;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.Seed = ParseOptionValue(argv[i], argv[i + 1], 1, UINT32_MAX / 2);
+            i++;
+        } else if (argv[i][0] == '-' || config.SocketPath != NULL) {
+            PrintUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        } else {
+            config.SocketPath = argv[i];
+        }
+    }
+
+    if (config.SocketPath == NULL || config.InsertPercent + config.ScanPercent > 100) {
+        PrintUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    MaxIdentifier = Prepare(&config);
+    for (uint32_t i = 0; i < config.NumSteps; i++) {
+        RunStep(&config, config.ThreadCounts[i]);
+    }
+    return 0;
+}
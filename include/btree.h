@@ -0,0 +1,186 @@
+/*
+ * The table: a B+tree of slotted leaf pages keyed on ID.
+ */
+#ifndef BTREE_H
+#define BTREE_H
+
+#include "pager.h"
+#include "row.h"
+#include "sink.h"
+
+enum {
+    BTREE_MAX_DEPTH = 16,
+    TABLE_MAX_INDEXES = 2,
+    TABLE_MIN_PAGES = 8, // * Smallest page limit a table may be opened with
+    FILE_FORMAT_VERSION = 2
+};
+
+typedef enum {
+    EXECUTE_SUCCESS,
+    EXECUTE_DUPLICATE_KEY,
+    EXECUTE_TABLE_FULL,
+    EXECUTE_INDEX_EXISTS
+} EExecuteResult;
+
+typedef enum {
+    INDEX_USERNAME,
+    INDEX_EMAIL
+} EIndexColumn;
+
+typedef enum {
+    NODE_INTERNAL,
+    NODE_LEAF
+} ENodeType;
+
+// * Page numbers are 32 bits and NumPages has to count the last one, so no
+// * file holds more pages than this (16 TiB). DBOptions.MaxPages sets a lower limit.
+static const uint32_t TABLE_MAX_PAGES = UINT32_MAX - 1;
+
+/*
+ * File Header Layout
+ *
+ * Page 0 describes the file. A file is only opened if its magic, format
+ * version and page size match this build. The root page never moves once
+ * the file is created. Pages the tree and indexes give up are chained from
+ * FreePage through their first four bytes and reused before the file grows.
+ * NumRows is kept up to date by every statement that inserts, so counting
+ * the whole table reads no pages.
+ */
+static const char* const FILE_MAGIC = "SIMPLEDB";
+static const uint32_t FILE_HEADER_PAGE_NUM = 0;
+static const uint32_t FILE_MAGIC_SIZE = 8;
+static const uint32_t FILE_MAGIC_OFFSET = 0;
+static const uint32_t FILE_FORMAT_VERSION_SIZE = sizeof(uint32_t);
+static const uint32_t FILE_FORMAT_VERSION_OFFSET = FILE_MAGIC_OFFSET + FILE_MAGIC_SIZE;
+static const uint32_t FILE_PAGE_SIZE_SIZE = sizeof(uint32_t);
+static const uint32_t FILE_PAGE_SIZE_OFFSET = FILE_FORMAT_VERSION_OFFSET + FILE_FORMAT_VERSION_SIZE;
+static const uint32_t FILE_ROOT_PAGE_SIZE = sizeof(uint32_t);
+static const uint32_t FILE_ROOT_PAGE_OFFSET = FILE_PAGE_SIZE_OFFSET + FILE_PAGE_SIZE_SIZE;
+static const uint32_t FILE_FREE_PAGE_SIZE = sizeof(uint32_t);
+static const uint32_t FILE_FREE_PAGE_OFFSET = FILE_ROOT_PAGE_OFFSET + FILE_ROOT_PAGE_SIZE;
+static const uint32_t FILE_CATALOG_PAGE_SIZE = sizeof(uint32_t);
+static const uint32_t FILE_CATALOG_PAGE_OFFSET = FILE_FREE_PAGE_OFFSET + FILE_FREE_PAGE_SIZE;
+static const uint32_t FILE_NUM_ROWS_SIZE = sizeof(uint64_t);
+static const uint32_t FILE_NUM_ROWS_OFFSET = FILE_CATALOG_PAGE_OFFSET + FILE_CATALOG_PAGE_SIZE + sizeof(uint32_t); // * After four reserved bytes
+static const uint32_t FILE_HEADER_SIZE = FILE_NUM_ROWS_OFFSET + FILE_NUM_ROWS_SIZE;
+
+/*
+ * Common Node Header Layout
+ */
+static const uint32_t NODE_TYPE_SIZE = sizeof(uint8_t);
+static const uint32_t NODE_TYPE_OFFSET = 0;
+static const uint32_t IS_ROOT_SIZE = sizeof(uint8_t);
+static const uint32_t IS_ROOT_OFFSET = NODE_TYPE_OFFSET + NODE_TYPE_SIZE;
+static const uint32_t COMMON_NODE_HEADER_SIZE = sizeof(uint32_t); // * Type, root flag and two reserved bytes
+
+/*
+ * Leaf Node Header Layout
+ */
+static const uint32_t LEAF_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
+static const uint32_t LEAF_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
+static const uint32_t LEAF_NODE_NEXT_LEAF_SIZE = sizeof(uint32_t);
+static const uint32_t LEAF_NODE_NEXT_LEAF_OFFSET = LEAF_NODE_NUM_CELLS_OFFSET + LEAF_NODE_NUM_CELLS_SIZE;
+static const uint32_t LEAF_NODE_CONTENT_START_SIZE = sizeof(uint16_t);
+static const uint32_t LEAF_NODE_CONTENT_START_OFFSET = LEAF_NODE_NEXT_LEAF_OFFSET + LEAF_NODE_NEXT_LEAF_SIZE;
+static const uint32_t LEAF_NODE_FRAGMENTED_SIZE = sizeof(uint16_t);
+static const uint32_t LEAF_NODE_FRAGMENTED_OFFSET = LEAF_NODE_CONTENT_START_OFFSET + LEAF_NODE_CONTENT_START_SIZE;
+static const uint32_t LEAF_NODE_HEADER_SIZE = LEAF_NODE_FRAGMENTED_OFFSET + LEAF_NODE_FRAGMENTED_SIZE;
+
+/*
+ * Leaf Node Body Layout
+ *
+ * A slot directory grows up from the header, one slot per row in key order:
+ * the row's ID, then the offset and length of its cell. Cells are packed
+ * down from the end of the page. Cell space freed by a split is counted as
+ * fragmented until the page is compacted.
+ */
+static const uint32_t LEAF_NODE_KEY_SIZE = sizeof(uint32_t);
+static const uint32_t LEAF_NODE_KEY_OFFSET = 0;
+static const uint32_t LEAF_NODE_CELL_OFFSET_SIZE = sizeof(uint16_t);
+static const uint32_t LEAF_NODE_CELL_OFFSET_OFFSET = LEAF_NODE_KEY_OFFSET + LEAF_NODE_KEY_SIZE;
+static const uint32_t LEAF_NODE_CELL_LENGTH_SIZE = sizeof(uint16_t);
+static const uint32_t LEAF_NODE_CELL_LENGTH_OFFSET = LEAF_NODE_CELL_OFFSET_OFFSET + LEAF_NODE_CELL_OFFSET_SIZE;
+static const uint32_t LEAF_NODE_SLOT_SIZE = LEAF_NODE_KEY_SIZE + LEAF_NODE_CELL_OFFSET_SIZE + LEAF_NODE_CELL_LENGTH_SIZE;
+static const uint32_t LEAF_NODE_SPACE_FOR_CELLS = PAGE_USABLE_SIZE - LEAF_NODE_HEADER_SIZE;
+static const uint32_t LEAF_NODE_MAX_CELLS = LEAF_NODE_SPACE_FOR_CELLS / (LEAF_NODE_SLOT_SIZE + 2 * CELL_LENGTH_PREFIX_SIZE);
+
+/*
+ * Internal Node Header Layout
+ */
+static const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
+static const uint32_t INTERNAL_NODE_RIGHT_CHILD_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_RIGHT_CHILD_OFFSET = INTERNAL_NODE_NUM_KEYS_OFFSET + INTERNAL_NODE_NUM_KEYS_SIZE;
+static const uint32_t INTERNAL_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_SIZE;
+
+/*
+ * Internal Node Body Layout
+ *
+ * Cell i holds child i and the largest key stored under it. Keys greater
+ * than the last cell's key live under the right child.
+ */
+static const uint32_t INTERNAL_NODE_CHILD_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_KEY_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_CELL_SIZE = INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE;
+static const uint32_t INTERNAL_NODE_MAX_CELLS = (PAGE_USABLE_SIZE - INTERNAL_NODE_HEADER_SIZE) / INTERNAL_NODE_CELL_SIZE;
+
+/*
+ * Many statements may read the table at once, but only one may modify it:
+ * writers hold WriteLock for the whole statement, commit included. Readers
+ * take no table lock. They latch pages shared from the root down, releasing
+ * each parent once the child is latched, and walk the leaves latching the
+ * next one before releasing the current. The writer latches its path
+ * exclusively and releases the ancestors above any node the insert cannot
+ * split, so pages above that point stay open to readers.
+ */
+typedef struct ScanPool ScanPool;
+
+typedef struct {
+    Pager* Pager;
+    uint32_t RootPageNum;
+    pthread_mutex_t WriteLock;
+    ResultSink* Output; // * The shell's output; server sessions bring their own
+    const char* StatsPath;
+    uint32_t ScanThreads;
+    uint32_t MaxPages; // * Inserts that could grow the file past this many pages fail with EXECUTE_TABLE_FULL
+    ScanPool* ScanPool; // * Threads parallel selects run on, NULL if selects scan on one
+    uint32_t IndexPages[TABLE_MAX_INDEXES]; // * Header page of each column's hash index, 0 for none; read atomically
+    uint64_t NumRows; // * Mirrors the file header's row count; read atomically
+} Table;
+
+typedef struct {
+    Table* Table;
+    uint32_t PageNum;
+    uint32_t CellNum;
+    void* Page; // * Pinned and latched shared leaf the cursor points into, NULL at the end of the table
+    bool EndOfTable; // * Indicates a position one past the last element
+} Cursor;
+
+uint32_t* FileCatalogPage(void* header);
+uint32_t AllocatePage(Table* table);
+void FreePage(Table* table, uint32_t pageNum);
+void TableAddRows(Table* table, uint64_t count);
+uint32_t* LeafNodeNumCells(void* node);
+uint32_t* LeafNodeNextLeaf(void* node);
+uint32_t* LeafNodeKey(void* node, uint32_t cellNum);
+void* LeafNodeValue(void* node, uint32_t cellNum);
+bool LeafNodeInsertCell(void* node, uint32_t cellNum, uint32_t key, const void* cell, uint32_t length);
+void InitializeLeafNode(void* node);
+Table* OpenDB(const char* filename, const DBOptions* options);
+void PrintConstants();
+void PrintTree(Pager* pager, uint32_t pageNum, uint32_t indentationLevel);
+uint32_t LeafNodeFindCell(void* node, uint32_t key);
+uint32_t TableDescend(Table* table, uint32_t key, ELatchMode latch, uint32_t* pathPages, uint32_t* pathChildren, uint32_t* depth, uint32_t* latchedDepth, void** leaf, uint32_t* maxKey);
+void CursorSkipExhaustedLeaves(Cursor* cursor);
+Cursor* TableFind(Table* table, uint32_t key);
+Cursor* TableStart(Table* table);
+void CloseCursor(Cursor* cursor);
+void* CursorValue(Cursor* cursor);
+uint32_t CursorKey(Cursor* cursor);
+void CursorAdvance(Cursor* cursor);
+uint32_t TableSplitRange(Table* table, uint32_t keyFrom, uint32_t keyTo, uint32_t target, uint32_t** uppers, bool* reachedLeaves);
+EExecuteResult InternalNodeInsert(Table* table, uint32_t* pathPages, uint32_t* pathChildren, uint32_t depth, uint32_t leftPageNum, uint32_t leftMaxKey, uint32_t rightPageNum);
+EExecuteResult TableInsert(Table* table, const RowFields* rows, uint32_t numRows, bool* inserted, uint32_t* numConsumed);
+void CloseDB(Table* table);
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * CRC32C (Castagnoli) checksums of pages.
+ */
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "common.h"
+
+/*
+ * Uses the SSE4.2 crc32 instruction when the CPU has it, eight bytes at a
+ * time, and otherwise a table-driven software version that computes the same
+ * values, so files move freely between machines. The choice is made once,
+ * on the first call.
+ */
+uint32_t Crc32c(uint32_t crc, const void* data, size_t length);
+
+#endif
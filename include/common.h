@@ -0,0 +1,21 @@
+/*
+ * Standard headers and macros shared by every module.
+ */
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#define ASSERT(condition, msg)                                   \
+    if (!(condition)) {                                          \
+        fprintf(stderr, "%s(%s: %d)\n", msg, __FILE__, __LINE__);\
+        __builtin_trap();                                        \
+    }                                                            \
+
+#define size_of_attribute(Struct, Attribute) sizeof(((Struct*)0)->Attribute)
+
+#endif
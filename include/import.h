@@ -0,0 +1,16 @@
+/*
+ * Bulk loading of CSV files.
+ */
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "btree.h"
+
+enum {
+    IMPORT_BUFFER_SIZE = 1 << 20,
+    IMPORT_MAX_PENDING_PAGES = 8
+};
+
+void ImportCSV(Table* table, const char* path);
+
+#endif
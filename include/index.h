@@ -0,0 +1,82 @@
+/*
+ * Persistent hash indexes on the username and email columns.
+ */
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "btree.h"
+
+enum {
+    INDEX_LOAD_PERCENT = 75 // * Average bucket fill past which the next bucket splits
+};
+
+/*
+ * Catalog Page Layout
+ *
+ * Found through the file header's catalog page field, allocated by the
+ * first `create index`. Holds the header page of each column's index, 0 for none.
+ */
+static const uint32_t CATALOG_INDEX_PAGE_SIZE = sizeof(uint32_t);
+
+/*
+ * Index Header Page Layout
+ *
+ * Buckets [0, 2^Level + SplitBucket) exist. Their page numbers are kept in
+ * map pages of INDEX_MAP_ENTRIES each, listed at the end of the header.
+ * While bucket SplitBucket is being split, SplitReadPage is the next page of
+ * its chain to redistribute, SplitWritePage the page its remaining entries
+ * are packed into and SplitNewTail the last page of the new bucket; all
+ * three are 0 otherwise. Overflow pages emptied by splits go on the file's
+ * free list.
+ */
+static const uint32_t INDEX_LEVEL_OFFSET = 0;
+static const uint32_t INDEX_SPLIT_BUCKET_OFFSET = INDEX_LEVEL_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_NUM_ENTRIES_OFFSET = INDEX_SPLIT_BUCKET_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_SPLIT_READ_PAGE_OFFSET = INDEX_NUM_ENTRIES_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_SPLIT_WRITE_PAGE_OFFSET = INDEX_SPLIT_READ_PAGE_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_SPLIT_NEW_TAIL_OFFSET = INDEX_SPLIT_WRITE_PAGE_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_MAP_PAGES_OFFSET = INDEX_SPLIT_NEW_TAIL_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_MAX_MAP_PAGES = (PAGE_USABLE_SIZE - INDEX_MAP_PAGES_OFFSET) / sizeof(uint32_t);
+static const uint32_t INDEX_MAP_ENTRIES = PAGE_USABLE_SIZE / sizeof(uint32_t);
+static const uint32_t INDEX_MAX_BUCKETS = INDEX_MAX_MAP_PAGES * INDEX_MAP_ENTRIES;
+
+/*
+ * Index Bucket Page Layout
+ *
+ * A bucket is a chain of pages linked through NextOverflow. Each entry is
+ * the hash of a column value and the ID of the row holding it, unsorted.
+ */
+static const uint32_t INDEX_BUCKET_NUM_ENTRIES_OFFSET = 0;
+static const uint32_t INDEX_BUCKET_NEXT_OVERFLOW_OFFSET = INDEX_BUCKET_NUM_ENTRIES_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_BUCKET_HEADER_SIZE = INDEX_BUCKET_NEXT_OVERFLOW_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_ENTRY_HASH_OFFSET = 0;
+static const uint32_t INDEX_ENTRY_KEY_OFFSET = INDEX_ENTRY_HASH_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_ENTRY_SIZE = INDEX_ENTRY_KEY_OFFSET + sizeof(uint32_t);
+static const uint32_t INDEX_BUCKET_MAX_ENTRIES = (PAGE_USABLE_SIZE - INDEX_BUCKET_HEADER_SIZE) / INDEX_ENTRY_SIZE;
+
+/*
+ * Linear Hashing
+ *
+ * A value lives in bucket hash mod 2^Level, or hash mod 2^(Level + 1) if that
+ * bucket has already been split this round. Once the entries average more
+ * than INDEX_LOAD_PERCENT of a page per bucket, bucket SplitBucket is split
+ * into itself and bucket SplitBucket + 2^Level, so the index grows one
+ * bucket at a time. A split moves one page of the old chain per insert, so
+ * an insert modifies a bounded number of pages however long the chain; until
+ * the last page is moved, lookups in the splitting bucket read both chains.
+ * A lookup reads the header, one map page and the bucket's chain, which is
+ * one page unless the column repeats a value many times.
+ *
+ * Entries name rows by ID rather than position, since leaf splits move rows
+ * between pages; the row is then fetched from the B+tree and compared, which
+ * also weeds out hash collisions. Writers hold the header page's latch
+ * exclusively for a whole insert and readers hold it shared for a lookup, so
+ * the other index pages need no latches of their own.
+ */
+void OpenIndexes(Table* table);
+uint32_t IndexHash(const char* value, uint32_t length);
+EExecuteResult CreateIndex(Table* table, EIndexColumn column);
+void IndexInsertRow(Table* table, uint32_t key, const char* username, uint32_t usernameLength, const char* email, uint32_t emailLength);
+bool IndexLookup(Table* table, EIndexColumn column, const char* value, uint32_t length, uint32_t keyFrom, uint32_t keyTo, uint32_t** keys, uint32_t* numKeys);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Reading statements from the shell, one line at a time.
+ */
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "common.h"
+
+enum {
+    ALLOC_SIZE = 64
+};
+
+typedef struct {
+    char* Buffer;
+    size_t BufferLength;
+    ssize_t InputLength;
+} InputBuffer;
+
+InputBuffer* NewInputBuffer();
+void ReadLine(InputBuffer* inputBuffer);
+void CloseInputBuffer(InputBuffer* inputBuffer);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Page access: a CLOCK buffer pool or a memory map of the file, made
+ * durable through a write-ahead log of page images.
+ */
+#ifndef PAGER_H
+#define PAGER_H
+
+#include "common.h"
+
+#include <pthread.h>
+#include <time.h>
+
+enum {
+    POOL_DEFAULT_FRAMES = 1024,
+    POOL_MIN_FRAMES = 32,
+    WAL_DEFAULT_COMMIT_BATCH = 32,
+    WAL_DEFAULT_COMMIT_INTERVAL_MS = 50,
+    WAL_DEFAULT_CHECKPOINT_MB = 32,
+    PAGE_LATCH_CHUNK = 4096,
+    READAHEAD_DEFAULT_PAGES = 32,
+    READAHEAD_MAX_PAGES = 128,
+    READAHEAD_STREAMS = 8,
+    READAHEAD_QUEUE_SIZE = 32,
+    READAHEAD_THREADS = 2,
+    FLUSHER_DEFAULT_RATE_MB = 16,
+    FLUSHER_BATCH_PAGES = 32,
+    FLUSHER_IDLE_MS = 100,
+    VERIFY_CHUNK_PAGES = 64,
+    VERIFY_MAX_THREADS = 64
+};
+
+typedef enum {
+    PAGER_ACCESS_SEQUENTIAL,
+    PAGER_ACCESS_RANDOM
+} EPagerAccess;
+
+typedef enum {
+    PAGE_DIRTY = 1 << 0,
+    PAGE_LOG_PENDING = 1 << 1,
+    PAGE_VERIFIED = 1 << 2 // * Checksum checked, or created by this process
+} EPageFlag;
+
+typedef enum {
+    LATCH_NONE,
+    LATCH_SHARED,
+    LATCH_EXCLUSIVE
+} ELatchMode;
+
+typedef enum {
+    WAL_RECORD_PAGE = 1,
+    WAL_RECORD_COMMIT = 2
+} EWalRecordType;
+
+static const uint32_t PAGE_SIZE = 4096;
+
+/*
+ * Page Trailer Layout
+ *
+ * The last four bytes of every page hold the CRC32C of the rest of it,
+ * stamped each time the page is written to the database file and checked
+ * the first time it is requested after being read back. Page layouts only
+ * use the PAGE_USABLE_SIZE bytes in front of it. A page of all zeros is one
+ * the file was extended with but that never got written.
+ */
+static const uint32_t PAGE_CHECKSUM_SIZE = sizeof(uint32_t);
+static const uint32_t PAGE_CHECKSUM_OFFSET = PAGE_SIZE - PAGE_CHECKSUM_SIZE;
+static const uint32_t PAGE_USABLE_SIZE = PAGE_CHECKSUM_OFFSET;
+static const size_t MMAP_MIN_RESERVATION = (size_t)64 << 30;
+static const off_t MMAP_MIN_GROWTH = 1 << 20;
+
+typedef struct {
+    uint32_t PoolFrames;
+    uint32_t CommitBatch;      // * Statements that share one fdatasync of the log
+    uint32_t CommitIntervalMs; // * Longest a logged statement waits for that fdatasync
+    uint32_t CheckpointMB;     // * Log size that triggers a checkpoint
+    bool UseMmap;              // * Serve pages from a memory map instead of the buffer pool
+    const char* StatsPath;     // * Where CloseDB writes the stats as JSON, NULL for nowhere
+    uint32_t ScanThreads;      // * Threads one select may scan with, 0 for one per online CPU
+    uint32_t ReadAheadPages;   // * Pages read ahead of a sequential run of misses, 0 to turn it off
+    uint32_t FlushRateMB;      // * Most the background flusher writes per second, 0 for no flusher
+    uint32_t MaxPages;         // * Pages inserting rows may grow the file to, 0 for TABLE_MAX_PAGES
+} DBOptions;
+
+/*
+ * Write-Ahead Log Record Layout
+ *
+ * Every insert appends one PAGE record per page it modified, carrying the
+ * full after-image, followed by a COMMIT record. Recovery only applies page
+ * images whose COMMIT made it to disk.
+ */
+typedef struct {
+    uint32_t Type;
+    uint32_t PageNum;  // * Page of a PAGE record, number of PAGE records for a COMMIT
+    uint64_t Sequence; // * Starts at 1 after every truncation
+    uint32_t Checksum; // * Over the header with this field zeroed, then the payload
+    uint32_t Reserved;
+} WalRecordHeader;
+
+typedef struct {
+    pthread_mutex_t Lock; // * Serializes appends, syncs and truncation
+    int FileDescriptor;
+    char* Filename;
+    off_t FileLength;
+    uint64_t NextSequence;
+    uint32_t UnsyncedCommits;
+    struct timespec FirstUnsyncedAt;
+    uint32_t CommitBatch;
+    uint32_t CommitIntervalMs;
+    off_t CheckpointBytes;
+
+    // * Syncs the log once the oldest unsynced commit has waited
+    // * CommitIntervalMs, so the bound holds when no statement follows it
+    pthread_t Syncer;
+    pthread_cond_t SyncerWake; // * Signalled by the first unsynced commit and on close
+    bool Stopping;
+} Wal;
+
+typedef struct {
+    uint32_t PageNum;
+    uint32_t PinCount;
+    bool InUse;
+    bool Dirty;
+    bool LogPending; // * Modified by the running statement and not yet in the log
+    bool Referenced; // * CLOCK second-chance bit
+    bool Loading; // * Being read from the file without Lock held; requests wait for it
+    bool Prefetched; // * Loaded by read-ahead and not requested since
+    bool Verified; // * Checksum checked, or the page is new; the first request checks it otherwise
+} Frame;
+
+// * A page of the running statement evicted before the statement committed
+typedef struct {
+    uint32_t PageNum;
+    off_t Offset; // * Of its image in the log
+} SpilledPage;
+
+// * A run of consecutive page numbers being requested, such as a scan over
+// * leaves a bulk load laid out in order
+typedef struct {
+    uint32_t NextPage; // * The page that continues the run
+    uint32_t ReadAheadEnd; // * One past the last page already read or queued
+} ReadStream;
+
+// * Consecutive pages for a read-ahead thread to load with one preadv
+typedef struct {
+    uint32_t PageNum;
+    uint32_t NumPages;
+    uint32_t FrameIndices[READAHEAD_MAX_PAGES];
+} ReadRequest;
+
+/*
+ * Concurrency
+ *
+ * Lock guards the page table, the frames, the page flags and the pin counts.
+ * It is held for the length of one pager call and never while waiting on a
+ * page latch. Page latches are reader/writer locks keyed by page number, so
+ * a latch stays valid while its page moves between frames; the B+tree takes
+ * them around the pages it reads or modifies. Lock is taken before Wal->Lock
+ * when both are needed. The pending pages belong to the one statement allowed
+ * to write at a time, which is also the only caller of CommitPager.
+ */
+typedef struct {
+    pthread_mutex_t Lock;
+    pthread_rwlock_t** Latches; // * One chunk of PAGE_LATCH_CHUNK latches per entry, allocated on first use
+    int FileDescriptor;
+    off_t FileLength;
+    uint32_t NumPages;
+    uint32_t NumFrames;
+    void* Arena; // * NumFrames pages carved out of one page-aligned allocation
+    Frame* Frames;
+    uint32_t* PageTable; // * Open-addressed page number -> frame index + 1, 0 marks an empty bucket
+    uint32_t PageTableMask;
+    uint32_t ClockHand;
+    uint32_t* PendingPages; // * Pages modified by the running statement, in the order they were dirtied
+    uint32_t NumPendingPages;
+    uint32_t PendingPagesCapacity;
+    Wal* Wal;
+
+    // * Spilling. When every frame the clock could evict holds a page of the
+    // * running statement, one of them is written to the log as a PAGE record
+    // * ahead of the statement's COMMIT and its frame reused, so a statement
+    // * may modify more pages than the pool holds and still commit as one.
+    // * A miss on a spilled page reads it back from the log. Once the
+    // * statement commits and the log is synced, spilled pages are copied into
+    // * the database file. Nothing spills while CommitPager is logging.
+    SpilledPage* SpilledPages;
+    uint32_t NumSpilledPages;
+    uint32_t SpilledPagesCapacity;
+    uint32_t NumSpilledRecords; // * PAGE records the running statement's COMMIT has to count
+    bool Committing;
+
+    // * Read-ahead. A miss, or the first request for a prefetched page, that
+    // * continues one of the streams queues reads of the pages after it once
+    // * fewer than half of ReadAheadPages are left ahead. Read-ahead threads
+    // * load each request into frames marked Loading; frames that are never
+    // * requested are the first the clock evicts.
+    uint32_t ReadAheadPages; // * 0 in memory-mapped mode, where the kernel reads ahead
+    ReadStream Streams[READAHEAD_STREAMS];
+    uint32_t NextStream; // * Stream replaced by the next miss that continues none
+    uint32_t NumLoadingFrames;
+    ReadRequest* ReadQueue; // * Ring of READAHEAD_QUEUE_SIZE requests
+    uint32_t ReadQueueHead;
+    uint32_t ReadQueueLength;
+    pthread_cond_t ReadQueued;
+    pthread_cond_t PageLoaded;
+    pthread_t ReadThreads[READAHEAD_THREADS];
+    bool Stopping;
+
+    // * Background flusher. Writes committed dirty pages back in page order,
+    // * a batch at a time with Lock held, so a page can be neither pinned nor
+    // * modified while it is written. Pages are written only once the log
+    // * covering them is synced; the flusher syncs it itself only when the
+    // * oldest unsynced commit is past the commit interval. The checkpoint
+    // * that truncates the log then has little left to write.
+    uint32_t FlushRatePages; // * Pages per second, 0 when there is no flusher
+    uint32_t FlushCursor; // * Page the flusher's sweep continues from
+    uint32_t* FlushCandidates; // * NumFrames entries of scratch for sorting dirty pages
+    pthread_t Flusher;
+    pthread_cond_t FlusherWake;
+
+    // * Memory-mapped mode. The file is mapped MAP_PRIVATE so modified pages
+    // * stay copy-on-write in memory and only reach the file through the
+    // * checkpoint, after the log covering them. Reads of untouched pages go
+    // * straight to the page cache without a copy.
+    void* Mapping; // * NULL in buffer pool mode
+    size_t MappingLength; // * Reserved address space, larger than the file
+    uint8_t* PageFlags; // * EPageFlag bits for each page of the file
+    uint32_t MappedPins;
+} Pager;
+
+uint64_t ElapsedMs(struct timespec* since);
+void PagerAdvise(Pager* pager, EPagerAccess access);
+Pager* OpenPager(const char* filename, const DBOptions* options);
+void* GetPage(Pager* pager, uint32_t pageNum);
+void UnpinPage(Pager* pager, uint32_t pageNum);
+void MarkPageDirty(Pager* pager, uint32_t pageNum);
+void LatchPage(Pager* pager, uint32_t pageNum, ELatchMode mode);
+void UnlatchPage(Pager* pager, uint32_t pageNum);
+uint32_t CheckpointPager(Pager* pager);
+uint32_t VerifyPager(Pager* pager, uint32_t numThreads, uint32_t* numPages, uint32_t* numUnused);
+void CommitPager(Pager* pager);
+uint32_t GetUnusedPageNum(Pager* pager);
+void ClosePager(Pager* pager);
+
+#endif
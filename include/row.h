@@ -0,0 +1,46 @@
+/*
+ * Rows and their variable-length on-page encoding.
+ */
+#ifndef ROW_H
+#define ROW_H
+
+#include "common.h"
+
+enum {
+    COLUMN_USERNAME_SIZE = 32,
+    COLUMN_EMAIL_SIZE = 255
+};
+
+typedef struct {
+    uint32_t ID;
+    char Username[COLUMN_USERNAME_SIZE + 1];
+    char Email[COLUMN_EMAIL_SIZE + 1];
+} Row;
+
+// * A row whose strings stay where they were parsed, such as in the text of
+// * an insert statement, rather than being copied into a Row
+typedef struct {
+    uint32_t ID;
+    uint32_t UsernameLength;
+    uint32_t EmailLength;
+    const char* Username;
+    const char* Email;
+} RowFields;
+
+/*
+ * Leaf Node Cell Layout
+ *
+ * The row without its ID, which is already the slot's key: a one-byte
+ * username length, the username, a one-byte email length and the email,
+ * with no terminators or padding.
+ */
+static const uint32_t CELL_LENGTH_PREFIX_SIZE = sizeof(uint8_t);
+static const uint32_t LEAF_NODE_MAX_CELL_SIZE = 2 * CELL_LENGTH_PREFIX_SIZE + COLUMN_USERNAME_SIZE + COLUMN_EMAIL_SIZE;
+
+uint32_t SerializeRowFields(void* destination, const char* username, size_t usernameLength, const char* email, size_t emailLength);
+uint32_t SerializeRow(Row* source, void* destination);
+void CellFields(void* source, const char** username, uint32_t* usernameLength, const char** email, uint32_t* emailLength);
+void DeserializeRow(uint32_t key, void* source, Row* destination);
+void PrintRow(Row* row);
+
+#endif
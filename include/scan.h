@@ -0,0 +1,44 @@
+/*
+ * Selects that scan the table on several threads at once.
+ */
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "statement.h"
+
+enum {
+    SCAN_MAX_THREADS = 64,
+    SCAN_FRAMES_PER_THREAD = 8,       // * Pool frames kept per scan thread, so scans cannot pin the whole pool
+    SCAN_TASKS_PER_THREAD = 16,       // * Pieces per thread, so idle threads have something to steal
+    SCAN_MIN_TASK_LEAVES = 16,
+    SCAN_MIN_PARALLEL_KEYS = 4096,    // * Narrower id ranges run on the calling thread
+    SCAN_MAX_BUFFERED = 64 << 20      // * Bytes of rows held for in-order output before workers wait
+};
+
+/*
+ * Parallel Scan
+ *
+ * The key range is cut into tasks at subtree boundaries read from the upper
+ * levels of the tree, and each worker starts with a contiguous run of them
+ * in its own deque. A worker takes tasks from the front of its deque and,
+ * once it is empty, steals the back half of another's, so a thread held up
+ * by slow reads only delays the tasks it has already started. Each task is
+ * an ordinary scan of its key range, with its own cursor and latches.
+ *
+ * The calling thread emits results in task order: the rows of each task are
+ * buffered in a memory sink until every task before it has been written
+ * out, and aggregates are combined task by task in the same order. It runs
+ * the next task itself if no worker has claimed it yet, so workers that stop
+ * when too many rows are buffered can never wait on it.
+ *
+ * The workers are one pool of threads per table, started by OpenDB and
+ * joined by CloseDB. A select queues its scan with one seat per deque and
+ * idle workers take the seats in queue order, so concurrent selects share
+ * the pool. Seats still open when the calling thread has emitted every task
+ * are withdrawn; the tasks behind them were run by the others.
+ */
+ScanPool* OpenScanPool(Table* table);
+void CloseScanPool(ScanPool* pool);
+bool ParallelSelect(Statement* statement, Table* table, ResultSink* sink, ScanAggregate* aggregate);
+
+#endif
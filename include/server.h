@@ -0,0 +1,42 @@
+/*
+ * Serving many sessions at once over a Unix domain socket.
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "btree.h"
+
+enum {
+    SERVER_DEFAULT_WORKERS = 8,
+    SERVER_LISTEN_BACKLOG = 128,
+    SESSION_BUFFER_SIZE = 4096,
+    SESSION_MAX_LINE = 1 << 16,
+    SESSION_MESSAGE_SIZE = 256
+};
+
+/*
+ * Session Protocol
+ *
+ * A session is the shell over a socket. The server sends the "db > " prompt,
+ * the client sends one statement per line, and the server answers with what
+ * the shell would print followed by the next prompt, so a client knows a
+ * response is complete once it ends in a prompt. The only meta commands are
+ * .mode, which sets the output mode of the session, and .exit.
+ *
+ * Each worker serves one session at a time, from accept to disconnect, so
+ * NumWorkers bounds the sessions in flight; more clients queue in the listen
+ * backlog.
+ */
+typedef struct {
+    Table* Table;
+    int ListenFileDescriptor;
+    uint32_t NumWorkers;
+    pthread_t* Workers;
+    pthread_mutex_t Lock; // * Guards Stopping and SessionFileDescriptors
+    bool Stopping;
+    int* SessionFileDescriptors; // * One slot per worker, -1 when it is idle
+} Server;
+
+void RunServer(Table* table, const char* socketPath, uint32_t numWorkers);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Buffered output of select results in text, CSV or binary form.
+ */
+#ifndef SINK_H
+#define SINK_H
+
+#include "common.h"
+
+enum {
+    OUTPUT_BUFFER_SIZE = 1 << 20,
+    MEMORY_SINK_INITIAL_SIZE = 1 << 16
+};
+
+typedef enum {
+    OUTPUT_MODE_TEXT,
+    OUTPUT_MODE_CSV,
+    OUTPUT_MODE_BINARY
+} EOutputMode;
+
+/*
+ * Select results are formatted into one large buffer and written out only
+ * when it fills or the statement ends. A memory sink has no file descriptor
+ * and grows its buffer instead, holding output until the caller copies it
+ * into another sink.
+ *
+ * Binary mode writes each row as a little-endian u16 byte count of the rest
+ * of the record, the u32 id, then the username and email, each prefixed with
+ * a u8 length. An aggregate result is a single record of u64 values, with
+ * UINT64_MAX for a min or max over no rows.
+ */
+typedef struct {
+    int FileDescriptor;
+    bool OwnsFileDescriptor; // * Opened by .output and closed when replaced
+    bool Disconnected; // * The reader is gone; later output is dropped
+    EOutputMode Mode;
+    char* Buffer;
+    size_t Length;
+    size_t Capacity;
+} ResultSink;
+
+ResultSink* OpenResultSink();
+ResultSink* OpenMemorySink(EOutputMode mode);
+void SinkFlush(ResultSink* sink);
+void SinkRedirect(ResultSink* sink, int fileDescriptor, bool ownsFileDescriptor);
+void CloseResultSink(ResultSink* sink);
+void SinkWrite(ResultSink* sink, const void* data, size_t length);
+void SinkUnsigned(ResultSink* sink, uint64_t value);
+void SinkRow(ResultSink* sink, uint32_t key, void* source);
+
+#endif
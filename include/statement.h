@@ -0,0 +1,121 @@
+/*
+ * Parsing and execution of insert, select and create index statements.
+ */
+#ifndef STATEMENT_H
+#define STATEMENT_H
+
+#include "btree.h"
+#include "input.h"
+
+enum {
+    SELECT_MAX_AGGREGATES = 8,
+    INSERT_MAX_ROWS = 128, // * Rows one `insert values` may list
+    STATEMENT_MAX_PARAMETERS = 3 * INSERT_MAX_ROWS
+};
+
+typedef enum {
+    PREPARE_SUCCESS,
+    PREPARE_NEGATIVE_ID,
+    PREPARE_STRING_TOO_LONG,
+    PREPARE_SYNTAX_ERROR,
+    PREPARE_UNRECOGNIZED_STATEMENT,
+    PREPARE_TOO_MANY_ROWS,
+    PREPARE_UNKNOWN_NAME,
+    PREPARE_PARAMETER_COUNT
+} EPrepareResult;
+
+typedef enum {
+    STATEMENT_INSERT,
+    STATEMENT_SELECT,
+    STATEMENT_CREATE_INDEX
+} EStatementType;
+
+typedef enum {
+    STRING_MATCH_ANY,
+    STRING_MATCH_EQUAL,
+    STRING_MATCH_PREFIX,
+    STRING_MATCH_SUFFIX,
+    STRING_MATCH_CONTAINS
+} EStringMatch;
+
+typedef enum {
+    AGGREGATE_COUNT,
+    AGGREGATE_MIN,
+    AGGREGATE_MAX
+} EAggregate;
+
+// * What a `?` in a prepared statement stands for
+typedef enum {
+    PARAMETER_ID,
+    PARAMETER_USERNAME,
+    PARAMETER_EMAIL,
+    PARAMETER_ID_PREDICATE,
+    PARAMETER_USERNAME_PREDICATE,
+    PARAMETER_EMAIL_PREDICATE
+} EParameterTarget;
+
+typedef struct {
+    EParameterTarget Target;
+    uint32_t Row;         // * Row of an insert the value goes into
+    const char* Operator; // * Comparison of a select predicate
+} Parameter;
+
+typedef struct {
+    EStringMatch Match;
+    uint32_t PatternLength;
+    char Pattern[COLUMN_EMAIL_SIZE + 1];
+} StringPredicate;
+
+typedef struct {
+    EStatementType Type;
+    // * Inclusive key range for select. A plain `select` covers [0, UINT32_MAX].
+    // * Every id predicate narrows it; an empty range has KeyFrom > KeyTo.
+    uint32_t KeyFrom;
+    uint32_t KeyTo;
+    StringPredicate Username;
+    StringPredicate Email;
+    // * Columns of an aggregate select in the order given. None prints rows.
+    EAggregate Aggregates[SELECT_MAX_AGGREGATES];
+    uint32_t NumAggregates;
+    EIndexColumn IndexColumn; // * Column of a create index
+    uint32_t NumParameters;
+    uint32_t NumRows;
+    // * Rows of an insert. Their strings point into the statement's text, so
+    // * the text must outlive the statement.
+    RowFields Rows[INSERT_MAX_ROWS];
+    // * Slots of the `?`s, in order. Binding copies the statement only up to
+    // * its last row, so these stay last.
+    Parameter Parameters[STATEMENT_MAX_PARAMETERS];
+} Statement;
+
+// * A statement parsed once by `.prepare` and run by `.exec` with new values
+typedef struct {
+    char* Name;
+    char* Text; // * Copy of the statement's text, which the plan points into
+    Statement* Plan;
+} PreparedStatement;
+
+// * The prepared statements of one shell or server session
+typedef struct {
+    PreparedStatement* Statements;
+    uint32_t NumStatements;
+} PreparedStatements;
+
+// * Running count, min(id) and max(id) of the rows a select matched so far
+typedef struct {
+    uint64_t Count;
+    uint32_t MinKey;
+    uint32_t MaxKey;
+} ScanAggregate;
+
+EPrepareResult PrepareStatement(InputBuffer* inputBuffer, Statement* statement);
+PreparedStatements* NewPreparedStatements();
+EPrepareResult PrepareNamed(PreparedStatements* prepared, const char* text);
+EPrepareResult BindPrepared(PreparedStatements* prepared, char* arguments, Statement* statement);
+void ClosePreparedStatements(PreparedStatements* prepared);
+EExecuteResult ExecuteInsert(Statement* statement, Table* table);
+void ScanRange(Statement* statement, Table* table, uint32_t keyFrom, uint32_t keyTo, ResultSink* sink, ScanAggregate* aggregate);
+EExecuteResult ExecuteSelect(Statement* statement, Table* table, ResultSink* sink);
+EExecuteResult ExecuteStatement(Statement* statement, Table* table, ResultSink* output);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Process-wide counters and latency histograms for the hot paths.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+
+enum {
+    STATS_HISTOGRAM_BUCKETS = 48
+};
+
+typedef enum {
+    STATS_GET_PAGE_MISS,
+    STATS_READ_AHEAD,
+    STATS_READ_AHEAD_WAIT,
+    STATS_FLUSH_PAGE,
+    STATS_WAL_WRITE,
+    STATS_WAL_SYNC,
+    STATS_PREPARE_STATEMENT,
+    STATS_EXECUTE_INSERT,
+    STATS_EXECUTE_SELECT,
+    STATS_CREATE_INDEX,
+    STATS_NUM_TIMERS
+} EStatsTimer;
+
+// * Bucket i counts operations that took [2^i, 2^(i+1)) nanoseconds
+typedef struct {
+    uint64_t Count;
+    uint64_t TotalNs;
+    uint64_t MaxNs;
+    uint64_t Buckets[STATS_HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+// * Page hits are only timed in aggregate, through the statements that make
+// * them; timing each one would cost more than the lookup. In memory-mapped
+// * mode every request counts as a hit, since page faults are not visible.
+typedef struct {
+    uint64_t PageRequests;
+    uint64_t PageMisses;
+    uint64_t BytesRead;
+    uint64_t PagesPrefetched;
+    uint64_t PagesFlushed;
+    uint64_t BytesFlushed;
+    uint64_t WalBytesWritten;
+    uint64_t WalSyncs;
+    uint64_t PagesSpilled; // * Uncommitted pages evicted to the log
+    LatencyHistogram Timers[STATS_NUM_TIMERS];
+} EngineStats;
+
+extern EngineStats Stats;
+
+uint64_t StatsNow();
+void StatsRecord(EStatsTimer timer, uint64_t startedAt);
+void ResetStats();
+void PrintStats();
+void PrintStatsJson(FILE* stream);
+
+#endif
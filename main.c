@@ -1,390 +1,211 @@
-#include <errno.h>
+#include "import.h"
+#include "server.h"
+#include "statement.h"
+#include "stats.h"
+
 #include <fcntl.h>
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define ASSERT(condition, msg)                                   \
-    if (!(condition)) {                                          \
-        fprintf(stderr, "%s(%s: %d)\n", msg, __FILE__, __LINE__);\
-        __builtin_trap();                                        \
-    }                                                            \
-
-#define size_of_attribute(Struct, Attribute) sizeof(((Struct*)0)->Attribute)
-
-enum {
-    ALLOC_SIZE = 64,
-    COLUMN_USERNAME_SIZE = 32,
-    COLUMN_EMAIL_SIZE = 255,
-    TABLE_MAX_PAGES = 100
-};
-
-typedef struct {
-    char* Buffer;
-    size_t BufferLength;
-    ssize_t InputLength;
-} InputBuffer;
-
-typedef enum {
-    EXECUTE_SUCCESS,
-    EXECUTE_TABLE_FULL
-} EExecuteResult;
-
 typedef enum {
     META_COMMAND_SUCCESS,
     META_COMMAND_UNRECOGNIZED_COMMAND
 } EMetaCommandResult;
 
-typedef enum {
-    PREPARE_SUCCESS,
-    PREPARE_NEGATIVE_ID,
-    PREPARE_STRING_TOO_LONG,
-    PREPARE_SYNTAX_ERROR,
-    PREPARE_UNRECOGNIZED_STATEMENT
-} EPrepareResult;
-
-typedef enum {
-    STATEMENT_INSERT,
-    STATEMENT_SELECT
-} EStatementType;
-
-typedef struct {
-    uint32_t ID;
-    char Username[COLUMN_USERNAME_SIZE + 1];
-    char Email[COLUMN_EMAIL_SIZE + 1];
-} Row;
-
-typedef struct {
-    EStatementType Type;
-    Row RowToInsert;
-} Statement;
-
-const uint16_t ID_SIZE = size_of_attribute(Row, ID);
-const uint16_t USERNAME_SIZE = size_of_attribute(Row, Username);
-const uint16_t EMAIL_SIZE = size_of_attribute(Row, Email);
-const uint16_t ID_OFFSET = 0;
-const uint16_t USERNAME_OFFSET = ID_OFFSET + ID_SIZE;
-const uint16_t EMAIL_OFFSET = USERNAME_OFFSET + USERNAME_SIZE;
-const uint16_t ROW_SIZE = ID_SIZE + USERNAME_SIZE + EMAIL_SIZE;
-const uint32_t PAGE_SIZE = 4096;
-const uint32_t ROWS_PER_PAGE = PAGE_SIZE / ROW_SIZE;
-const uint32_t TABLE_MAX_ROWS = ROWS_PER_PAGE * TABLE_MAX_PAGES;
-
-typedef struct {
-    int FileDescriptor;
-    uint32_t FileLength;
-    void* Pages[TABLE_MAX_PAGES];
-} Pager;
-
-typedef struct {
-    Pager* Pager;
-    uint32_t NumRows;
-} Table;
-
-InputBuffer* NewInputBuffer() {
-    InputBuffer* inputBuffer = (InputBuffer*)malloc(sizeof(InputBuffer));
-    inputBuffer->Buffer = NULL;
-    inputBuffer->BufferLength = 0;
-    inputBuffer->InputLength = 0;
-
-    return inputBuffer;
-}
-
 void PrintPrompt() { printf("db > "); }
 
-ssize_t GetLine(char** lineptr, size_t* n, FILE* stream) {
-    ASSERT(lineptr != NULL && n != NULL && stream != NULL, "NULLs in parameters are not allowed");
-    if (!*lineptr) {
-        *lineptr = (char*)malloc(ALLOC_SIZE);
-        if (!*lineptr) {
-            return -1;
-        } else {
-            *n = ALLOC_SIZE;
-        }
-    }
-    char* cur = NULL;
-    size_t len = 0;
-    while (!feof(stream)) {
-        cur = *lineptr + len;
-        if (!fgets(cur, (int)(*n - len), stream)) {
-            return -1;
-        }
-        len += strlen(cur);
-        if ((*lineptr)[len - 1] != '\n') { // * 개행 문자 확인
-            char* new = (char*)realloc(*lineptr, *n += ALLOC_SIZE);
-            if (!new) {
-                return -1;
-            } else {
-                *lineptr = new;
-            }
-        } else {
-            return (*lineptr)[--len] = 0, len; // NOLINT
-        }
-    }
-    return -1;
-}
-
-void ReadLine(InputBuffer* inputBuffer) {
-    ssize_t bytesRead = GetLine(&(inputBuffer->Buffer), &(inputBuffer->BufferLength), stdin);
-    if (bytesRead <= 0) {
-        printf("Error reading input\n");
-        exit(EXIT_FAILURE); // NOLINT
-    }
-    // * Ignore trailing newline
-    // inputBuffer->InputLength = bytesRead - 1;
-    // inputBuffer->Buffer[bytesRead - 1] = 0;
-}
-
-Pager* OpenPager(const char* filename) {
-    int fileDescriptor = open(filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
-
-    if (fileDescriptor == -1) {
-        printf("Unable to open file\n");
-        exit(EXIT_FAILURE);
-    }
-
-    off_t fileLength = lseek(fileDescriptor, 0, SEEK_END);
-
-    Pager* pager = malloc(sizeof(Pager));
-    pager->FileDescriptor = fileDescriptor;
-    pager->FileLength = fileLength;
-
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++) {
-        pager->Pages[i] = NULL;
-    }
-
-    return pager;
-}
-
-Table* OpenDB(const char* filename) {
-    Pager* pager = OpenPager(filename);
-    uint32_t numRows = pager->FileLength / ROW_SIZE;
-
-    Table* table = malloc(sizeof(Table));
-    table->Pager = pager;
-    table->NumRows = numRows;
-
-    return table;
-}
-
-void* GetPage(Pager* pager, uint32_t pageNum) {
-    if (pageNum > TABLE_MAX_PAGES) {
-        printf("Tried to fetch page number out of bounds. %d > %d\n", pageNum, TABLE_MAX_PAGES);
-        exit(EXIT_FAILURE);
-    }
-
-    if (pager->Pages[pageNum] == NULL) {
-        // Cache miss. Allocate memory and load from file.
-        void* page = malloc(PAGE_SIZE);
-        uint32_t numPages = pager->FileLength / PAGE_SIZE;
-
-        if (pager->FileLength % PAGE_SIZE) {
-            numPages += 1;
-        }
-
-        if (pageNum <= numPages) {
-            lseek(pager->FileDescriptor, pageNum * PAGE_SIZE, SEEK_SET);
-            ssize_t bytes_read = read(pager->FileDescriptor, page, PAGE_SIZE);
-            if (bytes_read == -1) {
-                printf("Error reading file: %d\n", errno);
-                exit(EXIT_FAILURE);
-            }
-        }
-        pager->Pages[pageNum] = page;
-    }
-    return pager->Pages[pageNum];
-}
-
-void* GetRowSlot(Table* table, uint32_t rowNum) {
-    uint32_t pageNum = rowNum / ROWS_PER_PAGE;
-    void* page = GetPage(table->Pager, pageNum);
-    uint32_t rowOffset = rowNum % ROWS_PER_PAGE;
-    uint32_t byte_offset = rowOffset * ROW_SIZE;
-    return page + byte_offset;
-}
-
-void SerializeRow(Row* source, void* destination) {
-    memcpy(destination + ID_OFFSET, &(source->ID), ID_SIZE);
-    strncpy(destination + USERNAME_OFFSET, source->Username, USERNAME_SIZE);
-    strncpy(destination + EMAIL_OFFSET, source->Email, EMAIL_SIZE);
-}
-
-void DeserializeRow(void* source, Row* destination) {
-    memcpy(&(destination->ID), source + ID_OFFSET, ID_SIZE);
-    memcpy(&(destination->Username), source + USERNAME_OFFSET, USERNAME_SIZE);
-    memcpy(&(destination->Email), source + EMAIL_OFFSET, EMAIL_SIZE);
-}
-
-void PrintRow(Row* row) {
-    printf("%d, %s, %s\n", row->ID, row->Username, row->Email);
-}
-
-void CloseInputBuffer(InputBuffer* inputBuffer) {
-    free(inputBuffer->Buffer);
-    free(inputBuffer);
-}
-
-void FlushPager(Pager* pager, uint32_t pageNum, uint32_t size) {
-    if (pager->Pages[pageNum] == NULL) {
-        printf("Tried to flush null page\n");
-        exit(EXIT_FAILURE);
-    }
-
-    off_t offset = lseek(pager->FileDescriptor, pageNum * PAGE_SIZE, SEEK_SET);
-
-    if (offset == -1) {
-        printf("Error seeking: %d\n", errno);
-        exit(EXIT_FAILURE);
-    }
-
-    ssize_t bytesWritten = write(pager->FileDescriptor, pager->Pages[pageNum], size);
-
-    if (bytesWritten == -1) {
-        printf("Error writing: %d\n", errno);
-        exit(EXIT_FAILURE);
-    }
-}
-
-void CloseDB(Table* table) {
-    Pager* pager = table->Pager;
-    uint32_t numFullPages = table->NumRows / ROWS_PER_PAGE;
-
-    for (uint32_t i = 0; i < numFullPages; i++) {
-        if (pager->Pages[i] == NULL) {
-            continue;
-        }
-        FlushPager(pager, i, PAGE_SIZE);
-        free(pager->Pages[i]);
-        pager->Pages[i] = NULL;
-    }
-
-    uint32_t numAdditionalRows = table->NumRows % ROWS_PER_PAGE;
-    if (numAdditionalRows > 0) {
-        uint32_t pageNum = numFullPages;
-        if (pager->Pages[pageNum] != NULL) {
-            FlushPager(pager, pageNum, numAdditionalRows * ROW_SIZE);
-            free(pager->Pages[pageNum]);
-            pager->Pages[pageNum] = NULL;
-        }
-    }
-
-    int result = close(pager->FileDescriptor);
-    if (result == -1) {
-        printf("Error closing db file.\n");
-        exit(EXIT_FAILURE);
-    }
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++) {
-        void* page = pager->Pages[i];
-        if (page) {
-            free(page);
-            pager->Pages[i] = NULL;
-        }
-    }
-    free(pager);
-    free(table);
-}
-
 EMetaCommandResult DoMetaCommand(InputBuffer* inputBuffer, Table* table) {
     if (strcmp(inputBuffer->Buffer, ".exit") == 0) {
         CloseInputBuffer(inputBuffer);
         CloseDB(table);
         exit(EXIT_SUCCESS); // NOLINT
+    } else if (strcmp(inputBuffer->Buffer, ".btree") == 0) {
+        printf("Tree:\n");
+        PrintTree(table->Pager, table->RootPageNum, 0);
+        return META_COMMAND_SUCCESS;
+    } else if (strncmp(inputBuffer->Buffer, ".import ", 8) == 0) {
+        ImportCSV(table, inputBuffer->Buffer + 8);
+        return META_COMMAND_SUCCESS;
+    } else if (strncmp(inputBuffer->Buffer, ".mode ", 6) == 0) {
+        const char* mode = inputBuffer->Buffer + 6;
+        if (strcmp(mode, "text") == 0) {
+            table->Output->Mode = OUTPUT_MODE_TEXT;
+        } else if (strcmp(mode, "csv") == 0) {
+            table->Output->Mode = OUTPUT_MODE_CSV;
+        } else if (strcmp(mode, "binary") == 0) {
+            table->Output->Mode = OUTPUT_MODE_BINARY;
+        } else {
+            printf("Unknown output mode '%s'. Use text, csv or binary.\n", mode);
+        }
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".output") == 0) {
+        SinkRedirect(table->Output, STDOUT_FILENO, false);
+        return META_COMMAND_SUCCESS;
+    } else if (strncmp(inputBuffer->Buffer, ".output ", 8) == 0) {
+        const char* path = inputBuffer->Buffer + 8;
+        int fileDescriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+        if (fileDescriptor == -1) {
+            printf("Unable to open output file '%s'.\n", path);
+            return META_COMMAND_SUCCESS;
+        }
+        SinkRedirect(table->Output, fileDescriptor, true);
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".stats") == 0) {
+        PrintStats();
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".stats json") == 0) {
+        PrintStatsJson(stdout);
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".stats reset") == 0) {
+        ResetStats();
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".checkpoint") == 0) {
+        // * Not in the middle of another session's statement, whose spilled
+        // * pages live in the log until it commits
+        pthread_mutex_lock(&table->WriteLock);
+        printf("Checkpoint wrote %d pages.\n", CheckpointPager(table->Pager));
+        pthread_mutex_unlock(&table->WriteLock);
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".verify") == 0) {
+        // * Write back every page first so the check covers all of them
+        pthread_mutex_lock(&table->WriteLock);
+        CheckpointPager(table->Pager);
+        pthread_mutex_unlock(&table->WriteLock);
+        uint32_t numPages, numUnused;
+        uint32_t numCorrupt = VerifyPager(table->Pager, table->ScanThreads, &numPages, &numUnused);
+        printf("Verified %d pages: %d unused, %d corrupt.\n", numPages, numUnused, numCorrupt);
+        return META_COMMAND_SUCCESS;
+    } else if (strcmp(inputBuffer->Buffer, ".constants") == 0) {
+        printf("Constants:\n");
+        PrintConstants();
+        return META_COMMAND_SUCCESS;
     } else {
         return META_COMMAND_UNRECOGNIZED_COMMAND;
     }
 }
 
-EPrepareResult PrepareInsert(InputBuffer* inputBuffer, Statement* statement) {
-    statement->Type = STATEMENT_INSERT;
-
-    char* keyword = strtok(inputBuffer->Buffer, " ");
-    char* identifierString = strtok(NULL, " ");
-    char* username = strtok(NULL, " ");
-    char* email = strtok(NULL, " ");
-
-    if (identifierString == NULL || username == NULL || email == NULL) {
-        return PREPARE_SYNTAX_ERROR;
-    }
-
-    int identifier = atoi(identifierString);
-
-    if (identifier < 0) {
-        return PREPARE_NEGATIVE_ID;
-    }
-    if (strlen(username) > COLUMN_USERNAME_SIZE) {
-        return  PREPARE_STRING_TOO_LONG;
-    }
-    if (strlen(email) > COLUMN_EMAIL_SIZE) {
-        return PREPARE_STRING_TOO_LONG;
-    }
-
-    statement->RowToInsert.ID = identifier;
-    strcpy(statement->RowToInsert.Username, username);
-    strcpy(statement->RowToInsert.Email, email);
-
-    return PREPARE_SUCCESS;
+void PrintUsage(char const* program) {
+    printf("Usage: %s [options] <database file>\n", program);
+    printf("  --frames N              buffer pool size in %d-byte pages (default %d, minimum %d)\n", PAGE_SIZE, POOL_DEFAULT_FRAMES, POOL_MIN_FRAMES);
+    printf("  --commit-batch N        statements per write-ahead log fdatasync (default %d)\n", WAL_DEFAULT_COMMIT_BATCH);
+    printf("  --commit-interval-ms N  longest a statement waits for that fdatasync (default %d)\n", WAL_DEFAULT_COMMIT_INTERVAL_MS);
+    printf("  --checkpoint-mb N       write-ahead log size that triggers a checkpoint (default %d)\n", WAL_DEFAULT_CHECKPOINT_MB);
+    printf("  --flush-rate-mb N       MB per second the background flusher writes back, 0 to turn it off (default %d)\n", FLUSHER_DEFAULT_RATE_MB);
+    printf("  --read-ahead N          pages read ahead of sequential misses, 0 to turn off (default %d, maximum %d)\n", READAHEAD_DEFAULT_PAGES, READAHEAD_MAX_PAGES);
+    printf("  --max-pages N           pages inserts may grow the file to (default %u, minimum %d)\n", TABLE_MAX_PAGES, TABLE_MIN_PAGES);
+    printf("  --scan-threads N        threads one select may scan with (default one per online CPU)\n");
+    printf("  --mmap                  serve pages from a memory map of the file instead of the buffer pool\n");
+    printf("  --import FILE           load id,username,email lines from FILE, then exit\n");
+    printf("  --stats-json FILE       write engine counters and latencies to FILE as JSON on close\n");
+    printf("  --listen SOCKET         serve sessions on a Unix domain socket until SIGINT or SIGTERM\n");
+    printf("  --workers N             sessions served at once with --listen (default %d)\n", SERVER_DEFAULT_WORKERS);
 }
 
-EPrepareResult PrepareStatement(InputBuffer* inputBuffer, Statement* statement) {
-    if (strncmp(inputBuffer->Buffer, "insert", 6) == 0) { // NOLINT
-        return PrepareInsert(inputBuffer, statement);
-    }
-    if (strcmp(inputBuffer->Buffer, "select") == 0) {
-        statement->Type = STATEMENT_SELECT;
-        return PREPARE_SUCCESS;
+uint32_t ParseOptionValue(char const* name, char const* value, long minimum) {
+    char* end = NULL;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < minimum || parsed > UINT32_MAX / 2) {
+        printf("Invalid value '%s' for %s.\n", value, name);
+        exit(EXIT_FAILURE);
     }
-
-    return PREPARE_UNRECOGNIZED_STATEMENT;
+    return (uint32_t)parsed;
 }
 
-EExecuteResult ExecuteInsert(Statement* statement, Table* table) {
-    if (table->NumRows >= TABLE_MAX_ROWS) {
-        return  EXECUTE_TABLE_FULL;
+int main(int argc, char const* argv[]) {
+    DBOptions options;
+    options.PoolFrames = POOL_DEFAULT_FRAMES;
+    options.CommitBatch = WAL_DEFAULT_COMMIT_BATCH;
+    options.CommitIntervalMs = WAL_DEFAULT_COMMIT_INTERVAL_MS;
+    options.CheckpointMB = WAL_DEFAULT_CHECKPOINT_MB;
+    options.UseMmap = false;
+    options.StatsPath = NULL;
+    options.ScanThreads = 0;
+    options.ReadAheadPages = READAHEAD_DEFAULT_PAGES;
+    options.FlushRateMB = FLUSHER_DEFAULT_RATE_MB;
+    options.MaxPages = 0;
+    char const* filename = NULL;
+    char const* importPath = NULL;
+    char const* listenPath = NULL;
+    uint32_t numWorkers = SERVER_DEFAULT_WORKERS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.PoolFrames = ParseOptionValue(argv[i], argv[i + 1], POOL_MIN_FRAMES);
+            i++;
+        } else if (strcmp(argv[i], "--commit-batch") == 0 && i + 1 < argc) {
+            options.CommitBatch = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--commit-interval-ms") == 0 && i + 1 < argc) {
+            options.CommitIntervalMs = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--checkpoint-mb") == 0 && i + 1 < argc) {
+            options.CheckpointMB = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--flush-rate-mb") == 0 && i + 1 < argc) {
+            options.FlushRateMB = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--read-ahead") == 0 && i + 1 < argc) {
+            options.ReadAheadPages = ParseOptionValue(argv[i], argv[i + 1], 0);
+            i++;
+        } else if (strcmp(argv[i], "--max-pages") == 0 && i + 1 < argc) {
+            options.MaxPages = ParseOptionValue(argv[i], argv[i + 1], TABLE_MIN_PAGES);
+            i++;
+        } else if (strcmp(argv[i], "--scan-threads") == 0 && i + 1 < argc) {
+            options.ScanThreads = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            options.UseMmap = true;
+        } else if (strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+            options.StatsPath = argv[++i];
+        } else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            importPath = argv[++i];
+        } else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            listenPath = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            numWorkers = ParseOptionValue(argv[i], argv[i + 1], 1);
+            i++;
+        } else if (argv[i][0] == '-' || filename != NULL) {
+            PrintUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        } else {
+            filename = argv[i];
+        }
     }
-    Row* rowToInsert = &(statement->RowToInsert);
-    SerializeRow(rowToInsert, GetRowSlot(table, table->NumRows));
-    table->NumRows += 1;
-    return EXECUTE_SUCCESS;
-}
 
-EExecuteResult ExecuteSelect(Statement* statement, Table* table) {
-    Row row;
-    for (uint32_t i = 0; i < table->NumRows; i++) {
-        DeserializeRow(GetRowSlot(table, i), &row);
-        PrintRow(&row);
+    if (filename == NULL) {
+        printf("Must supply a database filename.\n");
+        PrintUsage(argv[0]);
+        exit(EXIT_FAILURE);
     }
-    return EXECUTE_SUCCESS;
-}
+    Table* table = OpenDB(filename, &options);
 
-EExecuteResult ExecuteStatement(Statement* statement, Table* table) {
-    switch (statement->Type) {
-    case (STATEMENT_INSERT):
-        // printf("This is where we would do an insert.\n");
-        return ExecuteInsert(statement, table);
-    case (STATEMENT_SELECT):
-        // printf("This is where we would do a select.\n");
-        return ExecuteSelect(statement, table);
+    if (importPath != NULL) {
+        ImportCSV(table, importPath);
+        CloseDB(table);
+        return 0;
     }
-}
 
-int main(int argc, char const* argv[]) {
-    if (argc < 2) {
-        printf("Must supply a database filename.\new");
-        exit(EXIT_FAILURE);
+    if (listenPath != NULL) {
+        RunServer(table, listenPath, numWorkers);
+        CloseDB(table);
+        return 0;
     }
-    char const* filename = argv[1];
-    Table* table = OpenDB(filename);
 
     InputBuffer* inputBuffer = NewInputBuffer();
+    PreparedStatements* prepared = NewPreparedStatements();
     while (true) {
         PrintPrompt();
         ReadLine(inputBuffer);
 
-        if (inputBuffer->Buffer[0] == '.') {
+        Statement statement;
+        EPrepareResult prepareResult;
+        bool prepareOnly = strncmp(inputBuffer->Buffer, ".prepare ", 9) == 0;
+        if (prepareOnly) {
+            prepareResult = PrepareNamed(prepared, inputBuffer->Buffer + 9);
+        } else if (strncmp(inputBuffer->Buffer, ".exec ", 6) == 0) {
+            prepareResult = BindPrepared(prepared, inputBuffer->Buffer + 6, &statement);
+        } else if (inputBuffer->Buffer[0] == '.') {
             switch (DoMetaCommand(inputBuffer, table)) {
             case (META_COMMAND_SUCCESS):
                 continue;
@@ -392,10 +213,11 @@ int main(int argc, char const* argv[]) {
                 printf("Unrecognized command '%s'.\n", inputBuffer->Buffer);
                 continue;
             }
+        } else {
+            prepareResult = PrepareStatement(inputBuffer, &statement);
         }
 
-        Statement statement;
-        switch (PrepareStatement(inputBuffer, &statement)) {
+        switch (prepareResult) {
         case (PREPARE_SUCCESS):
             break;
         case (PREPARE_NEGATIVE_ID):
@@ -410,17 +232,34 @@ int main(int argc, char const* argv[]) {
         case (PREPARE_UNRECOGNIZED_STATEMENT):
             printf("Unrecognized keyword at start of '%s'.\n", inputBuffer->Buffer);
             continue;
+        case (PREPARE_TOO_MANY_ROWS):
+            printf("Too many rows. An insert takes at most %d.\n", INSERT_MAX_ROWS);
+            continue;
+        case (PREPARE_UNKNOWN_NAME):
+            printf("Unknown prepared statement.\n");
+            continue;
+        case (PREPARE_PARAMETER_COUNT):
+            printf("Wrong number of parameters.\n");
+            continue;
+        }
+        if (prepareOnly) {
+            continue;
         }
 
-        switch (ExecuteStatement(&statement, table)) {
+        switch (ExecuteStatement(&statement, table, table->Output)) {
         case (EXECUTE_SUCCESS):
             printf("Executed.\n");
             break;
+        case (EXECUTE_DUPLICATE_KEY):
+            printf("Error: Duplicate key.\n");
+            break;
         case (EXECUTE_TABLE_FULL):
             printf("Error: Table full.\n");
             break;
+        case (EXECUTE_INDEX_EXISTS):
+            printf("Error: Index already exists.\n");
+            break;
         }
     }
     return 0;
 }
-// Test Case : 40422, 김광호, unieye07@gmail.com
\ No newline at end of file
@@ -0,0 +1,865 @@
+#include "btree.h"
+#include "index.h"
+#include "scan.h"
+#include "stats.h"
+
+#include <string.h>
+#include <unistd.h>
+
+ENodeType GetNodeType(void* node) {
+    uint8_t value = *((uint8_t*)(node + NODE_TYPE_OFFSET));
+    return (ENodeType)value;
+}
+
+void SetNodeType(void* node, ENodeType type) {
+    uint8_t value = type;
+    *((uint8_t*)(node + NODE_TYPE_OFFSET)) = value;
+}
+
+bool IsNodeRoot(void* node) {
+    uint8_t value = *((uint8_t*)(node + IS_ROOT_OFFSET));
+    return (bool)value;
+}
+
+void SetNodeRoot(void* node, bool isRoot) {
+    uint8_t value = isRoot;
+    *((uint8_t*)(node + IS_ROOT_OFFSET)) = value;
+}
+
+uint32_t* FileFormatVersion(void* header) {
+    return header + FILE_FORMAT_VERSION_OFFSET;
+}
+
+uint32_t* FilePageSize(void* header) {
+    return header + FILE_PAGE_SIZE_OFFSET;
+}
+
+uint32_t* FileRootPage(void* header) {
+    return header + FILE_ROOT_PAGE_OFFSET;
+}
+
+uint32_t* FileFreePage(void* header) {
+    return header + FILE_FREE_PAGE_OFFSET;
+}
+
+uint32_t* FileCatalogPage(void* header) {
+    return header + FILE_CATALOG_PAGE_OFFSET;
+}
+
+uint64_t* FileNumRows(void* header) {
+    return header + FILE_NUM_ROWS_OFFSET;
+}
+
+uint32_t* LeafNodeNumCells(void* node) {
+    return node + LEAF_NODE_NUM_CELLS_OFFSET;
+}
+
+uint32_t* LeafNodeNextLeaf(void* node) {
+    return node + LEAF_NODE_NEXT_LEAF_OFFSET;
+}
+
+uint16_t* LeafNodeContentStart(void* node) {
+    return node + LEAF_NODE_CONTENT_START_OFFSET;
+}
+
+uint16_t* LeafNodeFragmentedBytes(void* node) {
+    return node + LEAF_NODE_FRAGMENTED_OFFSET;
+}
+
+void* LeafNodeSlot(void* node, uint32_t cellNum) {
+    return node + LEAF_NODE_HEADER_SIZE + cellNum * LEAF_NODE_SLOT_SIZE;
+}
+
+uint32_t* LeafNodeKey(void* node, uint32_t cellNum) {
+    return LeafNodeSlot(node, cellNum) + LEAF_NODE_KEY_OFFSET;
+}
+
+uint16_t* LeafNodeCellOffset(void* node, uint32_t cellNum) {
+    return LeafNodeSlot(node, cellNum) + LEAF_NODE_CELL_OFFSET_OFFSET;
+}
+
+uint16_t* LeafNodeCellLength(void* node, uint32_t cellNum) {
+    return LeafNodeSlot(node, cellNum) + LEAF_NODE_CELL_LENGTH_OFFSET;
+}
+
+void* LeafNodeValue(void* node, uint32_t cellNum) {
+    return node + *LeafNodeCellOffset(node, cellNum);
+}
+
+// * Bytes between the slot directory and the cells
+uint32_t LeafNodeFreeSpace(void* node) {
+    return *LeafNodeContentStart(node) - (LEAF_NODE_HEADER_SIZE + *LeafNodeNumCells(node) * LEAF_NODE_SLOT_SIZE);
+}
+
+// * Rewrites the cells back to back at the end of the page, folding the
+// * fragmented space into the free gap.
+void LeafNodeCompact(void* node) {
+    uint8_t copy[PAGE_USABLE_SIZE];
+    memcpy(copy, node, PAGE_USABLE_SIZE);
+
+    uint32_t contentStart = PAGE_USABLE_SIZE;
+    uint32_t numCells = *LeafNodeNumCells(node);
+    for (uint32_t i = 0; i < numCells; i++) {
+        uint16_t length = *LeafNodeCellLength(node, i);
+        contentStart -= length;
+        memcpy(node + contentStart, copy + *LeafNodeCellOffset(node, i), length);
+        *LeafNodeCellOffset(node, i) = contentStart;
+    }
+    *LeafNodeContentStart(node) = contentStart;
+    *LeafNodeFragmentedBytes(node) = 0;
+}
+
+// * Places a cell at position cellNum of the slot directory, compacting the
+// * page first if only the fragmented space makes it fit. Returns false if
+// * the page is full.
+bool LeafNodeInsertCell(void* node, uint32_t cellNum, uint32_t key, const void* cell, uint32_t length) {
+    uint32_t needed = LEAF_NODE_SLOT_SIZE + length;
+    if (LeafNodeFreeSpace(node) < needed) {
+        if (LeafNodeFreeSpace(node) + *LeafNodeFragmentedBytes(node) < needed) {
+            return false;
+        }
+        LeafNodeCompact(node);
+    }
+
+    uint32_t numCells = *LeafNodeNumCells(node);
+    if (cellNum < numCells) {
+        memmove(LeafNodeSlot(node, cellNum + 1), LeafNodeSlot(node, cellNum), (numCells - cellNum) * LEAF_NODE_SLOT_SIZE);
+    }
+
+    uint16_t contentStart = *LeafNodeContentStart(node) - length;
+    memcpy(node + contentStart, cell, length);
+    *LeafNodeContentStart(node) = contentStart;
+    *LeafNodeKey(node, cellNum) = key;
+    *LeafNodeCellOffset(node, cellNum) = contentStart;
+    *LeafNodeCellLength(node, cellNum) = length;
+    *LeafNodeNumCells(node) = numCells + 1;
+    return true;
+}
+
+// * Drops every slot from numCells on, leaving their cells as fragmented space
+void LeafNodeTruncate(void* node, uint32_t numCells) {
+    uint32_t oldNumCells = *LeafNodeNumCells(node);
+    for (uint32_t i = numCells; i < oldNumCells; i++) {
+        *LeafNodeFragmentedBytes(node) += *LeafNodeCellLength(node, i);
+    }
+    *LeafNodeNumCells(node) = numCells;
+}
+
+uint32_t* InternalNodeNumKeys(void* node) {
+    return node + INTERNAL_NODE_NUM_KEYS_OFFSET;
+}
+
+uint32_t* InternalNodeRightChild(void* node) {
+    return node + INTERNAL_NODE_RIGHT_CHILD_OFFSET;
+}
+
+uint32_t* InternalNodeCell(void* node, uint32_t cellNum) {
+    return node + INTERNAL_NODE_HEADER_SIZE + cellNum * INTERNAL_NODE_CELL_SIZE;
+}
+
+uint32_t* InternalNodeChild(void* node, uint32_t childNum) {
+    uint32_t numKeys = *InternalNodeNumKeys(node);
+    if (childNum > numKeys) {
+        printf("Tried to access child_num %d > num_keys %d\n", childNum, numKeys);
+        exit(EXIT_FAILURE);
+    } else if (childNum == numKeys) {
+        return InternalNodeRightChild(node);
+    } else {
+        return InternalNodeCell(node, childNum);
+    }
+}
+
+uint32_t* InternalNodeKey(void* node, uint32_t keyNum) {
+    return (void*)InternalNodeCell(node, keyNum) + INTERNAL_NODE_CHILD_SIZE;
+}
+
+void InitializeLeafNode(void* node) {
+    SetNodeType(node, NODE_LEAF);
+    SetNodeRoot(node, false);
+    *LeafNodeNumCells(node) = 0;
+    *LeafNodeNextLeaf(node) = 0; // * 0 represents no sibling
+    *LeafNodeContentStart(node) = PAGE_USABLE_SIZE;
+    *LeafNodeFragmentedBytes(node) = 0;
+}
+
+void InitializeInternalNode(void* node) {
+    SetNodeType(node, NODE_INTERNAL);
+    SetNodeRoot(node, false);
+    *InternalNodeNumKeys(node) = 0;
+}
+
+// * Page 0 of a new file, with the tree's root leaf at the page after it
+void InitializeFileHeader(Table* table) {
+    Pager* pager = table->Pager;
+    void* header = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    memset(header, 0, PAGE_SIZE);
+    memcpy(header + FILE_MAGIC_OFFSET, FILE_MAGIC, FILE_MAGIC_SIZE);
+    *FileFormatVersion(header) = FILE_FORMAT_VERSION;
+    *FilePageSize(header) = PAGE_SIZE;
+    MarkPageDirty(pager, FILE_HEADER_PAGE_NUM);
+
+    uint32_t rootPageNum = AllocatePage(table);
+    void* rootNode = GetPage(pager, rootPageNum);
+    InitializeLeafNode(rootNode);
+    SetNodeRoot(rootNode, true);
+    MarkPageDirty(pager, rootPageNum);
+    UnpinPage(pager, rootPageNum);
+
+    *FileRootPage(header) = rootPageNum;
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+    CommitPager(pager);
+}
+
+// * Reads the root and row count from page 0, refusing files of another format
+void ReadFileHeader(Table* table) {
+    Pager* pager = table->Pager;
+    void* header = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    if (memcmp(header + FILE_MAGIC_OFFSET, FILE_MAGIC, FILE_MAGIC_SIZE) != 0 || *FileFormatVersion(header) != FILE_FORMAT_VERSION ||
+        *FilePageSize(header) != PAGE_SIZE) {
+        printf("Not a format %d database file with %d-byte pages. Corrupt file.\n", FILE_FORMAT_VERSION, PAGE_SIZE);
+        exit(EXIT_FAILURE);
+    }
+    table->RootPageNum = *FileRootPage(header);
+    table->NumRows = *FileNumRows(header);
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+}
+
+// * Takes the first page off the free list, or a new one at the end of the
+// * file. Like GetUnusedPageNum, the page is only taken once it is fetched.
+// * Callers hold the table's WriteLock.
+uint32_t AllocatePage(Table* table) {
+    Pager* pager = table->Pager;
+    void* header = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    uint32_t pageNum = *FileFreePage(header);
+    if (pageNum == 0) {
+        UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+        return GetUnusedPageNum(pager);
+    }
+
+    void* page = GetPage(pager, pageNum);
+    *FileFreePage(header) = *(uint32_t*)page;
+    UnpinPage(pager, pageNum);
+    MarkPageDirty(pager, FILE_HEADER_PAGE_NUM);
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+    return pageNum;
+}
+
+// * Puts a page nothing points to any more on the free list. Callers hold the
+// * table's WriteLock.
+void FreePage(Table* table, uint32_t pageNum) {
+    Pager* pager = table->Pager;
+    void* header = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    void* page = GetPage(pager, pageNum);
+    *(uint32_t*)page = *FileFreePage(header);
+    *FileFreePage(header) = pageNum;
+    MarkPageDirty(pager, pageNum);
+    UnpinPage(pager, pageNum);
+    MarkPageDirty(pager, FILE_HEADER_PAGE_NUM);
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+}
+
+// * Counts inserted rows into the file header, so the statement's commit logs
+// * them with the rows. Callers hold the table's WriteLock.
+void TableAddRows(Table* table, uint64_t count) {
+    Pager* pager = table->Pager;
+    void* header = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    *FileNumRows(header) += count;
+    MarkPageDirty(pager, FILE_HEADER_PAGE_NUM);
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+    __atomic_fetch_add(&table->NumRows, count, __ATOMIC_RELAXED);
+}
+
+Table* OpenDB(const char* filename, const DBOptions* options) {
+    Pager* pager = OpenPager(filename, options);
+
+    Table* table = malloc(sizeof(Table));
+    table->Pager = pager;
+    pthread_mutex_init(&table->WriteLock, NULL);
+    table->Output = OpenResultSink();
+    table->StatsPath = options->StatsPath;
+    long onlineCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    table->ScanThreads = options->ScanThreads > 0 ? options->ScanThreads : onlineCpus > 0 ? (uint32_t)onlineCpus : 1;
+    table->MaxPages = options->MaxPages > 0 && options->MaxPages < TABLE_MAX_PAGES ? options->MaxPages : TABLE_MAX_PAGES;
+
+    if (pager->NumPages == 0) {
+        InitializeFileHeader(table);
+    }
+    ReadFileHeader(table);
+    OpenIndexes(table);
+    table->ScanPool = OpenScanPool(table);
+
+    return table;
+}
+
+void PrintConstants() {
+    printf("FILE_HEADER_SIZE: %d\n", FILE_HEADER_SIZE);
+    printf("PAGE_USABLE_SIZE: %d\n", PAGE_USABLE_SIZE);
+    printf("COMMON_NODE_HEADER_SIZE: %d\n", COMMON_NODE_HEADER_SIZE);
+    printf("LEAF_NODE_HEADER_SIZE: %d\n", LEAF_NODE_HEADER_SIZE);
+    printf("LEAF_NODE_SLOT_SIZE: %d\n", LEAF_NODE_SLOT_SIZE);
+    printf("LEAF_NODE_SPACE_FOR_CELLS: %d\n", LEAF_NODE_SPACE_FOR_CELLS);
+    printf("LEAF_NODE_MAX_CELL_SIZE: %d\n", LEAF_NODE_MAX_CELL_SIZE);
+    printf("LEAF_NODE_MAX_CELLS: %d\n", LEAF_NODE_MAX_CELLS);
+    printf("INTERNAL_NODE_MAX_CELLS: %d\n", INTERNAL_NODE_MAX_CELLS);
+}
+
+void Indent(uint32_t level) {
+    for (uint32_t i = 0; i < level; i++) {
+        printf("  ");
+    }
+}
+
+void PrintTree(Pager* pager, uint32_t pageNum, uint32_t indentationLevel) {
+    void* node = GetPage(pager, pageNum);
+    uint32_t numKeys, child;
+
+    switch (GetNodeType(node)) {
+    case (NODE_LEAF):
+        numKeys = *LeafNodeNumCells(node);
+        Indent(indentationLevel);
+        printf("- leaf (size %d)\n", numKeys);
+        for (uint32_t i = 0; i < numKeys; i++) {
+            Indent(indentationLevel + 1);
+            printf("- %d\n", *LeafNodeKey(node, i));
+        }
+        break;
+    case (NODE_INTERNAL):
+        numKeys = *InternalNodeNumKeys(node);
+        Indent(indentationLevel);
+        printf("- internal (size %d)\n", numKeys);
+        for (uint32_t i = 0; i < numKeys; i++) {
+            child = *InternalNodeChild(node, i);
+            PrintTree(pager, child, indentationLevel + 1);
+
+            Indent(indentationLevel + 1);
+            printf("- key %d\n", *InternalNodeKey(node, i));
+        }
+        child = *InternalNodeRightChild(node);
+        PrintTree(pager, child, indentationLevel + 1);
+        break;
+    }
+    UnpinPage(pager, pageNum);
+}
+
+// * Returns the index of the first cell whose key is >= key, or numCells if there is none
+uint32_t LeafNodeFindCell(void* node, uint32_t key) {
+    uint32_t minIndex = 0;
+    uint32_t onePastMaxIndex = *LeafNodeNumCells(node);
+    while (onePastMaxIndex != minIndex) {
+        uint32_t index = (minIndex + onePastMaxIndex) / 2;
+        uint32_t keyAtIndex = *LeafNodeKey(node, index);
+        if (key == keyAtIndex) {
+            return index;
+        }
+        if (key < keyAtIndex) {
+            onePastMaxIndex = index;
+        } else {
+            minIndex = index + 1;
+        }
+    }
+    return minIndex;
+}
+
+// * Returns the index of the child which should contain the given key
+uint32_t InternalNodeFindChild(void* node, uint32_t key) {
+    uint32_t numKeys = *InternalNodeNumKeys(node);
+
+    // Binary search
+    uint32_t minIndex = 0;
+    uint32_t maxIndex = numKeys; // * there is one more child than key
+    while (minIndex != maxIndex) {
+        uint32_t index = (minIndex + maxIndex) / 2;
+        uint32_t keyToRight = *InternalNodeKey(node, index);
+        if (keyToRight >= key) {
+            maxIndex = index;
+        } else {
+            minIndex = index + 1;
+        }
+    }
+    return minIndex;
+}
+
+// * Whether one more insert under the node is certain not to split it
+bool NodeIsSafe(void* node) {
+    if (GetNodeType(node) == NODE_LEAF) {
+        return LeafNodeFreeSpace(node) + *LeafNodeFragmentedBytes(node) >= LEAF_NODE_SLOT_SIZE + LEAF_NODE_MAX_CELL_SIZE;
+    }
+    return *InternalNodeNumKeys(node) < INTERNAL_NODE_MAX_CELLS;
+}
+
+void UnlatchPath(Pager* pager, uint32_t* pathPages, uint32_t from, uint32_t to) {
+    for (uint32_t i = from; i < to; i++) {
+        UnlatchPage(pager, pathPages[i]);
+    }
+}
+
+// * Walks from the root down to the leaf that should contain the key, recording
+// * every internal page and the child index taken so splits can climb back up.
+// * The leaf is returned pinned through `leaf` and latched in the given mode.
+// * A shared descent holds one latch at a time past the root. An exclusive one
+// * also keeps the internal pages from pathPages[*latchedDepth] down latched,
+// * though unpinned, since a split below may reach them; callers release them
+// * with UnlatchPath. If maxKey is not NULL it receives the largest key the
+// * leaf may hold, taken from the separators passed on the way down.
+uint32_t TableDescend(Table* table, uint32_t key, ELatchMode latch, uint32_t* pathPages, uint32_t* pathChildren, uint32_t* depth, uint32_t* latchedDepth, void** leaf, uint32_t* maxKey) {
+    Pager* pager = table->Pager;
+    uint32_t pageNum = table->RootPageNum;
+    LatchPage(pager, pageNum, latch);
+    void* node = GetPage(pager, pageNum);
+    *depth = 0;
+    *latchedDepth = 0;
+    if (maxKey != NULL) {
+        *maxKey = UINT32_MAX;
+    }
+
+    while (GetNodeType(node) == NODE_INTERNAL) {
+        if (*depth >= BTREE_MAX_DEPTH) {
+            printf("Tree is deeper than %d levels. Corrupt file.\n", BTREE_MAX_DEPTH);
+            exit(EXIT_FAILURE);
+        }
+        uint32_t childIndex = InternalNodeFindChild(node, key);
+        pathPages[*depth] = pageNum;
+        pathChildren[*depth] = childIndex;
+        *depth += 1;
+        // * Separators tighten going down, so the deepest one bounding the child wins
+        if (maxKey != NULL && childIndex < *InternalNodeNumKeys(node)) {
+            *maxKey = *InternalNodeKey(node, childIndex);
+        }
+
+        uint32_t childPageNum = *InternalNodeChild(node, childIndex);
+        LatchPage(pager, childPageNum, latch);
+        UnpinPage(pager, pageNum);
+        if (latch == LATCH_SHARED) {
+            UnlatchPage(pager, pageNum);
+        }
+        pageNum = childPageNum;
+        node = GetPage(pager, pageNum);
+        if (latch == LATCH_EXCLUSIVE && NodeIsSafe(node)) {
+            UnlatchPath(pager, pathPages, *latchedDepth, *depth);
+            *latchedDepth = *depth;
+        }
+    }
+    *leaf = node;
+    return pageNum;
+}
+
+// * Moves a cursor forward over empty leaves and past the end of the current
+// * one, keeping exactly one leaf pinned and latched until the end of the
+// * table. The next leaf is latched before the current one is released.
+void CursorSkipExhaustedLeaves(Cursor* cursor) {
+    Pager* pager = cursor->Table->Pager;
+
+    while (cursor->CellNum >= *LeafNodeNumCells(cursor->Page)) {
+        // Advance to next leaf node
+        uint32_t nextPageNum = *LeafNodeNextLeaf(cursor->Page);
+        if (nextPageNum != 0) {
+            LatchPage(pager, nextPageNum, LATCH_SHARED);
+        }
+        UnpinPage(pager, cursor->PageNum);
+        UnlatchPage(pager, cursor->PageNum);
+        if (nextPageNum == 0) {
+            // This was rightmost leaf
+            cursor->Page = NULL;
+            cursor->EndOfTable = true;
+            return;
+        }
+        cursor->PageNum = nextPageNum;
+        cursor->CellNum = 0;
+        cursor->Page = GetPage(pager, nextPageNum);
+    }
+}
+
+// * Returns a cursor at the first row whose key is >= key
+Cursor* TableFind(Table* table, uint32_t key) {
+    uint32_t pathPages[BTREE_MAX_DEPTH], pathChildren[BTREE_MAX_DEPTH], depth, latchedDepth;
+    void* leaf;
+    uint32_t pageNum = TableDescend(table, key, LATCH_SHARED, pathPages, pathChildren, &depth, &latchedDepth, &leaf, NULL);
+
+    Cursor* cursor = malloc(sizeof(Cursor));
+    cursor->Table = table;
+    cursor->PageNum = pageNum;
+    cursor->Page = leaf;
+    cursor->CellNum = LeafNodeFindCell(leaf, key);
+    cursor->EndOfTable = false;
+
+    CursorSkipExhaustedLeaves(cursor);
+    return cursor;
+}
+
+Cursor* TableStart(Table* table) {
+    return TableFind(table, 0);
+}
+
+void CloseCursor(Cursor* cursor) {
+    if (cursor->Page != NULL) {
+        UnpinPage(cursor->Table->Pager, cursor->PageNum);
+        UnlatchPage(cursor->Table->Pager, cursor->PageNum);
+    }
+    free(cursor);
+}
+
+void* CursorValue(Cursor* cursor) {
+    return LeafNodeValue(cursor->Page, cursor->CellNum);
+}
+
+uint32_t CursorKey(Cursor* cursor) {
+    return *LeafNodeKey(cursor->Page, cursor->CellNum);
+}
+
+void CursorAdvance(Cursor* cursor) {
+    cursor->CellNum += 1;
+    CursorSkipExhaustedLeaves(cursor);
+}
+
+// * Splits [keyFrom, keyTo] at subtree boundaries, for scanning in parallel.
+// * Reads the tree a level at a time under shared latches, one page at a
+// * time, until at least `target` subtrees overlap the range or the next
+// * level is the leaves. Returns how many, with the largest key of each,
+// * clipped to the range and strictly increasing, in a malloc'd *uppers.
+// * Splits that land between levels only make the pieces less even; every
+// * key in the range is still covered by exactly one of them.
+uint32_t TableSplitRange(Table* table, uint32_t keyFrom, uint32_t keyTo, uint32_t target, uint32_t** uppers, bool* reachedLeaves) {
+    Pager* pager = table->Pager;
+    uint32_t capacity = target + 1;
+    uint32_t numNodes = 1;
+    uint32_t* pageNums = malloc(capacity * sizeof(uint32_t));
+    uint32_t* bounds = malloc(capacity * sizeof(uint32_t));
+    pageNums[0] = table->RootPageNum;
+    bounds[0] = keyTo;
+    *reachedLeaves = false;
+
+    for (uint32_t level = 0; numNodes < target && !*reachedLeaves; level++) {
+        if (level >= BTREE_MAX_DEPTH) {
+            printf("Tree is deeper than %d levels. Corrupt file.\n", BTREE_MAX_DEPTH);
+            exit(EXIT_FAILURE);
+        }
+        uint32_t numChildren = 0;
+        uint32_t childCapacity = numNodes + 1;
+        uint32_t* childPageNums = malloc(childCapacity * sizeof(uint32_t));
+        uint32_t* childBounds = malloc(childCapacity * sizeof(uint32_t));
+
+        for (uint32_t i = 0; i < numNodes && !*reachedLeaves; i++) {
+            LatchPage(pager, pageNums[i], LATCH_SHARED);
+            void* node = GetPage(pager, pageNums[i]);
+            if (GetNodeType(node) == NODE_LEAF) {
+                *reachedLeaves = true;
+            } else {
+                uint32_t numKeys = *InternalNodeNumKeys(node);
+                uint32_t lower = i == 0 ? 0 : bounds[i - 1];
+                for (uint32_t child = InternalNodeFindChild(node, i == 0 ? keyFrom : lower + 1); child <= numKeys; child++) {
+                    uint32_t upper = child < numKeys && *InternalNodeKey(node, child) < bounds[i] ? *InternalNodeKey(node, child) : bounds[i];
+                    if (numChildren > 0 && upper <= childBounds[numChildren - 1]) {
+                        continue; // * Stale separator; the previous piece already covers it
+                    }
+                    if (numChildren == childCapacity) {
+                        childCapacity *= 2;
+                        childPageNums = realloc(childPageNums, childCapacity * sizeof(uint32_t));
+                        childBounds = realloc(childBounds, childCapacity * sizeof(uint32_t));
+                    }
+                    childPageNums[numChildren] = *InternalNodeChild(node, child);
+                    childBounds[numChildren] = upper;
+                    numChildren++;
+                    if (upper >= bounds[i]) {
+                        break;
+                    }
+                }
+            }
+            UnpinPage(pager, pageNums[i]);
+            UnlatchPage(pager, pageNums[i]);
+        }
+
+        if (*reachedLeaves) {
+            free(childPageNums);
+            free(childBounds);
+        } else {
+            free(pageNums);
+            free(bounds);
+            pageNums = childPageNums;
+            bounds = childBounds;
+            numNodes = numChildren;
+        }
+    }
+
+    free(pageNums);
+    *uppers = bounds;
+    return numNodes;
+}
+
+// * The root must stay at RootPageNum, so its contents move to a fresh left
+// * child and the root is reinitialized as an internal node over both halves.
+void CreateNewRoot(Table* table, uint32_t rightChildPageNum, uint32_t leftMaxKey) {
+    Pager* pager = table->Pager;
+    void* root = GetPage(pager, table->RootPageNum);
+    uint32_t leftChildPageNum = AllocatePage(table);
+    void* leftChild = GetPage(pager, leftChildPageNum);
+
+    memcpy(leftChild, root, PAGE_USABLE_SIZE);
+    SetNodeRoot(leftChild, false);
+
+    InitializeInternalNode(root);
+    SetNodeRoot(root, true);
+    *InternalNodeNumKeys(root) = 1;
+    *InternalNodeChild(root, 0) = leftChildPageNum;
+    *InternalNodeKey(root, 0) = leftMaxKey;
+    *InternalNodeRightChild(root) = rightChildPageNum;
+
+    MarkPageDirty(pager, table->RootPageNum);
+    MarkPageDirty(pager, leftChildPageNum);
+    UnpinPage(pager, table->RootPageNum);
+    UnpinPage(pager, leftChildPageNum);
+}
+
+// * Shifts cells right of childIndex and inserts (leftPageNum, leftMaxKey) in
+// * front of the child that was just split; that slot now points to the new right half.
+void InternalNodeInsertAt(void* node, uint32_t childIndex, uint32_t leftPageNum, uint32_t leftMaxKey, uint32_t rightPageNum) {
+    uint32_t numKeys = *InternalNodeNumKeys(node);
+
+    if (childIndex == numKeys) {
+        *InternalNodeRightChild(node) = rightPageNum;
+    } else {
+        *InternalNodeChild(node, childIndex) = rightPageNum;
+        memmove(InternalNodeCell(node, childIndex + 1), InternalNodeCell(node, childIndex), (numKeys - childIndex) * INTERNAL_NODE_CELL_SIZE);
+    }
+    *InternalNodeNumKeys(node) = numKeys + 1;
+    *InternalNodeChild(node, childIndex) = leftPageNum;
+    *InternalNodeKey(node, childIndex) = leftMaxKey;
+}
+
+EExecuteResult InternalNodeSplitAndInsert(Table* table, uint32_t* pathPages, uint32_t* pathChildren, uint32_t depth, uint32_t leftPageNum, uint32_t leftMaxKey, uint32_t rightPageNum);
+
+// * Hooks a freshly split child into its parent at the given path level,
+// * splitting the parent in turn if it has no room left.
+EExecuteResult InternalNodeInsert(Table* table, uint32_t* pathPages, uint32_t* pathChildren, uint32_t depth, uint32_t leftPageNum, uint32_t leftMaxKey, uint32_t rightPageNum) {
+    if (depth == 0) {
+        // The split child was the root
+        CreateNewRoot(table, rightPageNum, leftMaxKey);
+        return EXECUTE_SUCCESS;
+    }
+
+    uint32_t parentPageNum = pathPages[depth - 1];
+    void* parent = GetPage(table->Pager, parentPageNum);
+    if (*InternalNodeNumKeys(parent) >= INTERNAL_NODE_MAX_CELLS) {
+        UnpinPage(table->Pager, parentPageNum);
+        return InternalNodeSplitAndInsert(table, pathPages, pathChildren, depth - 1, leftPageNum, leftMaxKey, rightPageNum);
+    }
+    InternalNodeInsertAt(parent, pathChildren[depth - 1], leftPageNum, leftMaxKey, rightPageNum);
+    MarkPageDirty(table->Pager, parentPageNum);
+    UnpinPage(table->Pager, parentPageNum);
+    return EXECUTE_SUCCESS;
+}
+
+EExecuteResult InternalNodeSplitAndInsert(Table* table, uint32_t* pathPages, uint32_t* pathChildren, uint32_t depth, uint32_t leftPageNum, uint32_t leftMaxKey, uint32_t rightPageNum) {
+    uint32_t oldPageNum = pathPages[depth];
+    uint32_t newPageNum = AllocatePage(table);
+
+    // * Gather every child and key, including the new one, in order
+    uint32_t children[INTERNAL_NODE_MAX_CELLS + 2];
+    uint32_t keys[INTERNAL_NODE_MAX_CELLS + 1];
+    void* oldNode = GetPage(table->Pager, oldPageNum);
+    uint32_t numKeys = *InternalNodeNumKeys(oldNode);
+    uint32_t childIndex = pathChildren[depth];
+
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < childIndex; i++, j++) {
+        children[j] = *InternalNodeChild(oldNode, i);
+        keys[j] = *InternalNodeKey(oldNode, i);
+    }
+    children[j] = leftPageNum;
+    keys[j] = leftMaxKey;
+    j++;
+    children[j] = rightPageNum;
+    for (uint32_t i = childIndex; i < numKeys; i++) {
+        keys[j] = *InternalNodeKey(oldNode, i);
+        j++;
+        children[j] = *InternalNodeChild(oldNode, i + 1);
+    }
+
+    // * The left half keeps splitIndex keys plus a right child; the key between
+    // * the halves becomes the left half's max key in the parent.
+    uint32_t totalKeys = numKeys + 1;
+    uint32_t splitIndex = totalKeys / 2;
+    void* newNode = GetPage(table->Pager, newPageNum);
+    InitializeInternalNode(newNode);
+
+    *InternalNodeNumKeys(oldNode) = splitIndex;
+    for (uint32_t i = 0; i < splitIndex; i++) {
+        *InternalNodeChild(oldNode, i) = children[i];
+        *InternalNodeKey(oldNode, i) = keys[i];
+    }
+    *InternalNodeRightChild(oldNode) = children[splitIndex];
+
+    *InternalNodeNumKeys(newNode) = totalKeys - splitIndex - 1;
+    for (uint32_t i = splitIndex + 1; i < totalKeys; i++) {
+        *InternalNodeChild(newNode, i - splitIndex - 1) = children[i];
+        *InternalNodeKey(newNode, i - splitIndex - 1) = keys[i];
+    }
+    *InternalNodeRightChild(newNode) = children[totalKeys];
+
+    MarkPageDirty(table->Pager, oldPageNum);
+    MarkPageDirty(table->Pager, newPageNum);
+    UnpinPage(table->Pager, oldPageNum);
+    UnpinPage(table->Pager, newPageNum);
+
+    return InternalNodeInsert(table, pathPages, pathChildren, depth, oldPageNum, keys[splitIndex], newPageNum);
+}
+
+// * Picks how many of the numCells + 1 rows (the new one at newCellNum) stay
+// * in the left page. Appending past the rightmost leaf leaves the old page
+// * full and starts the new one with the new row alone, so sequential
+// * inserts produce packed pages. Otherwise the split balances bytes.
+uint32_t LeafNodeSplitPoint(void* node, uint32_t newCellNum, uint32_t newLength) {
+    uint32_t numCells = *LeafNodeNumCells(node);
+    if (newCellNum == numCells && *LeafNodeNextLeaf(node) == 0) {
+        return numCells;
+    }
+
+    uint32_t total = LEAF_NODE_SLOT_SIZE + newLength;
+    for (uint32_t i = 0; i < numCells; i++) {
+        total += LEAF_NODE_SLOT_SIZE + *LeafNodeCellLength(node, i);
+    }
+
+    uint32_t leftBytes = 0;
+    uint32_t leftCount = 0;
+    for (uint32_t i = 0; i <= numCells && leftBytes < total / 2; i++) {
+        if (i == newCellNum) {
+            leftBytes += LEAF_NODE_SLOT_SIZE + newLength;
+        } else {
+            leftBytes += LEAF_NODE_SLOT_SIZE + *LeafNodeCellLength(node, i < newCellNum ? i : i - 1);
+        }
+        leftCount += 1;
+    }
+    if (leftCount > numCells) {
+        leftCount = numCells;
+    }
+    return leftCount > 0 ? leftCount : 1;
+}
+
+EExecuteResult LeafNodeSplitAndInsert(Cursor* cursor, uint32_t key, const void* cell, uint32_t length, uint32_t* pathPages, uint32_t* pathChildren, uint32_t depth) {
+    /*
+    Create a new node and move the upper rows over.
+    Insert the new row in one of the two nodes.
+    Update parent or create a new parent.
+    */
+    Pager* pager = cursor->Table->Pager;
+    // * Worst case every level splits and the root needs one more page
+    if ((uint64_t)GetUnusedPageNum(pager) + depth + 2 > cursor->Table->MaxPages) {
+        return EXECUTE_TABLE_FULL;
+    }
+    uint32_t newPageNum = AllocatePage(cursor->Table);
+
+    void* oldNode = cursor->Page;
+    void* newNode = GetPage(pager, newPageNum);
+    InitializeLeafNode(newNode);
+    *LeafNodeNextLeaf(newNode) = *LeafNodeNextLeaf(oldNode);
+    *LeafNodeNextLeaf(oldNode) = newPageNum;
+
+    uint32_t numCells = *LeafNodeNumCells(oldNode);
+    uint32_t leftCount = LeafNodeSplitPoint(oldNode, cursor->CellNum, length);
+
+    // * Rows are numbered as if the new one were already at CellNum
+    for (uint32_t i = leftCount; i <= numCells; i++) {
+        uint32_t destination = i - leftCount;
+        if (i == cursor->CellNum) {
+            LeafNodeInsertCell(newNode, destination, key, cell, length);
+        } else {
+            uint32_t source = i < cursor->CellNum ? i : i - 1;
+            LeafNodeInsertCell(newNode, destination, *LeafNodeKey(oldNode, source), LeafNodeValue(oldNode, source), *LeafNodeCellLength(oldNode, source));
+        }
+    }
+
+    if (cursor->CellNum < leftCount) {
+        LeafNodeTruncate(oldNode, leftCount - 1);
+        LeafNodeInsertCell(oldNode, cursor->CellNum, key, cell, length);
+    } else {
+        LeafNodeTruncate(oldNode, leftCount);
+        LeafNodeCompact(oldNode);
+    }
+
+    uint32_t leftMaxKey = *LeafNodeKey(oldNode, *LeafNodeNumCells(oldNode) - 1);
+    MarkPageDirty(pager, cursor->PageNum);
+    MarkPageDirty(pager, newPageNum);
+    UnpinPage(pager, newPageNum);
+    return InternalNodeInsert(cursor->Table, pathPages, pathChildren, depth, cursor->PageNum, leftMaxKey, newPageNum);
+}
+
+// * Inserts rows sorted by ID into the leaf the first one belongs in, then
+// * keeps going with the rows after it while they fall in the same leaf and
+// * fit, so a batch descends once per leaf rather than once per row. Only the
+// * first row of a run may split the leaf: the descent decided which
+// * ancestors to keep latched from the leaf as it was then. Rows whose ID is
+// * already taken are skipped and reported as a duplicate key. Sets
+// * inserted[i] for each row and numConsumed to the rows handled, at least
+// * one. Does not commit; callers decide where the statement ends and hold
+// * the table's WriteLock until it does.
+EExecuteResult TableInsert(Table* table, const RowFields* rows, uint32_t numRows, bool* inserted, uint32_t* numConsumed) {
+    uint32_t pathPages[BTREE_MAX_DEPTH], pathChildren[BTREE_MAX_DEPTH], depth, latchedDepth, maxKey;
+    void* node;
+    uint32_t pageNum = TableDescend(table, rows[0].ID, LATCH_EXCLUSIVE, pathPages, pathChildren, &depth, &latchedDepth, &node, &maxKey);
+
+    Cursor cursor;
+    cursor.Table = table;
+    cursor.PageNum = pageNum;
+    cursor.Page = node;
+    cursor.EndOfTable = false;
+
+    EExecuteResult result = EXECUTE_SUCCESS;
+    uint32_t numInserted = 0;
+    uint32_t i = 0;
+    for (; i < numRows && rows[i].ID <= maxKey; i++) {
+        uint32_t key = rows[i].ID;
+        cursor.CellNum = LeafNodeFindCell(node, key);
+        inserted[i] = false;
+        if (cursor.CellNum < *LeafNodeNumCells(node) && *LeafNodeKey(node, cursor.CellNum) == key) {
+            result = EXECUTE_DUPLICATE_KEY;
+            continue;
+        }
+
+        uint8_t cell[LEAF_NODE_MAX_CELL_SIZE];
+        uint32_t length = SerializeRowFields(cell, rows[i].Username, rows[i].UsernameLength, rows[i].Email, rows[i].EmailLength);
+        if (LeafNodeInsertCell(node, cursor.CellNum, key, cell, length)) {
+            inserted[i] = true;
+            numInserted++;
+            continue;
+        }
+        if (i > 0) {
+            break; // * Full; the next descent splits it with the right latches
+        }
+        EExecuteResult splitResult = LeafNodeSplitAndInsert(&cursor, key, cell, length, pathPages, pathChildren, depth);
+        if (splitResult == EXECUTE_SUCCESS) {
+            inserted[i] = true;
+            numInserted++;
+        } else {
+            result = splitResult;
+        }
+        i++;
+        break;
+    }
+    *numConsumed = i;
+
+    if (numInserted > 0) {
+        MarkPageDirty(table->Pager, pageNum);
+        TableAddRows(table, numInserted);
+    }
+    UnpinPage(table->Pager, pageNum);
+    UnlatchPage(table->Pager, pageNum);
+    UnlatchPath(table->Pager, pathPages, latchedDepth, depth);
+    return result;
+}
+
+void CloseDB(Table* table) {
+    CloseScanPool(table->ScanPool);
+    ClosePager(table->Pager);
+    CloseResultSink(table->Output);
+
+    if (table->StatsPath != NULL) {
+        FILE* stream = fopen(table->StatsPath, "w");
+        if (stream == NULL) {
+            printf("Unable to open stats file '%s'.\n", table->StatsPath);
+        } else {
+            PrintStatsJson(stream);
+            fclose(stream);
+        }
+    }
+    pthread_mutex_destroy(&table->WriteLock);
+    free(table);
+}
@@ -0,0 +1,129 @@
+#include "checksum.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE 1
+#endif
+
+static const uint32_t CRC32C_POLYNOMIAL = 0x82f63b78; // * Reversed Castagnoli polynomial
+static const size_t CRC32C_LANE_SIZE = 680; // * Three lanes cover all but 12 bytes of a page
+
+// * Slicing-by-8 tables: Table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t Crc32cTable[8][256];
+// * Shift[k][b] advances a CRC with byte k set to b over CRC32C_LANE_SIZE zero bytes
+static uint32_t Crc32cShift[4][256];
+static uint32_t (*Crc32cUpdate)(uint32_t crc, const uint8_t* bytes, size_t length);
+static pthread_once_t Crc32cOnce = PTHREAD_ONCE_INIT;
+
+uint32_t Crc32cSoftware(uint32_t crc, const uint8_t* bytes, size_t length) {
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        word ^= crc;
+        crc = Crc32cTable[7][word & 0xff] ^ Crc32cTable[6][(word >> 8) & 0xff] ^ Crc32cTable[5][(word >> 16) & 0xff] ^ Crc32cTable[4][(word >> 24) & 0xff] ^
+              Crc32cTable[3][(word >> 32) & 0xff] ^ Crc32cTable[2][(word >> 40) & 0xff] ^ Crc32cTable[1][(word >> 48) & 0xff] ^ Crc32cTable[0][word >> 56];
+        bytes += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        crc = Crc32cTable[0][(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+        bytes++;
+        length--;
+    }
+    return crc;
+}
+
+uint32_t Crc32cShiftLane(uint32_t crc) {
+    return Crc32cShift[0][crc & 0xff] ^ Crc32cShift[1][(crc >> 8) & 0xff] ^ Crc32cShift[2][(crc >> 16) & 0xff] ^ Crc32cShift[3][crc >> 24];
+}
+
+#ifdef CRC32C_HARDWARE
+// * The crc32 instruction has a latency of three cycles but can start one
+// * every cycle, so blocks are split into three lanes whose CRCs are computed
+// * side by side and then combined by shifting the earlier lanes' CRCs over
+// * the bytes that follow them.
+__attribute__((target("sse4.2"))) uint32_t Crc32cHardware(uint32_t crc, const uint8_t* bytes, size_t length) {
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (length >= 3 * CRC32C_LANE_SIZE) {
+        uint64_t crcB = 0;
+        uint64_t crcC = 0;
+        for (size_t i = 0; i < CRC32C_LANE_SIZE; i += 8) {
+            uint64_t wordA, wordB, wordC;
+            memcpy(&wordA, bytes + i, sizeof(wordA));
+            memcpy(&wordB, bytes + CRC32C_LANE_SIZE + i, sizeof(wordB));
+            memcpy(&wordC, bytes + 2 * CRC32C_LANE_SIZE + i, sizeof(wordC));
+            crc64 = _mm_crc32_u64(crc64, wordA);
+            crcB = _mm_crc32_u64(crcB, wordB);
+            crcC = _mm_crc32_u64(crcC, wordC);
+        }
+        crc64 = Crc32cShiftLane(Crc32cShiftLane((uint32_t)crc64) ^ (uint32_t)crcB) ^ (uint32_t)crcC;
+        bytes += 3 * CRC32C_LANE_SIZE;
+        length -= 3 * CRC32C_LANE_SIZE;
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        bytes += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+    while (length > 0) {
+        crc = _mm_crc32_u8(crc, *bytes);
+        bytes++;
+        length--;
+    }
+    return crc;
+}
+#endif
+
+void Crc32cInitialize() {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        Crc32cTable[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (uint32_t k = 1; k < 8; k++) {
+            Crc32cTable[k][b] = Crc32cTable[0][Crc32cTable[k - 1][b] & 0xff] ^ (Crc32cTable[k - 1][b] >> 8);
+        }
+    }
+
+    // * Shifting is linear, so the tables follow from the shifts of single bits
+    uint32_t bitShifts[32];
+    uint8_t zeros[CRC32C_LANE_SIZE];
+    memset(zeros, 0, sizeof(zeros));
+    for (uint32_t bit = 0; bit < 32; bit++) {
+        bitShifts[bit] = Crc32cSoftware(1u << bit, zeros, CRC32C_LANE_SIZE);
+    }
+    for (uint32_t k = 0; k < 4; k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t shifted = 0;
+            for (uint32_t bit = 0; bit < 8; bit++) {
+                if (b & (1u << bit)) {
+                    shifted ^= bitShifts[8 * k + bit];
+                }
+            }
+            Crc32cShift[k][b] = shifted;
+        }
+    }
+
+    Crc32cUpdate = Crc32cSoftware;
+#ifdef CRC32C_HARDWARE
+    if (__builtin_cpu_supports("sse4.2")) {
+        Crc32cUpdate = Crc32cHardware;
+    }
+#endif
+}
+
+uint32_t Crc32c(uint32_t crc, const void* data, size_t length) {
+    pthread_once(&Crc32cOnce, Crc32cInitialize);
+    return ~Crc32cUpdate(~crc, data, length);
+}
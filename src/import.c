@@ -0,0 +1,323 @@
+#include "import.h"
+#include "index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+// * Appends rows in ascending key order by filling the rightmost leaf in
+// * place. A full leaf is sealed as is rather than split in half, so bulk
+// * loaded pages come out packed, and the log sees each page once per batch of
+// * IMPORT_MAX_PENDING_PAGES sealed pages instead of once per row.
+typedef struct {
+    Table* Table;
+    void* Page; // * Pinned rightmost leaf, NULL until the next append descends again
+    uint32_t PageNum;
+    uint32_t PathPages[BTREE_MAX_DEPTH];
+    uint32_t PathChildren[BTREE_MAX_DEPTH];
+    uint32_t Depth;
+    uint32_t MaxKey;
+    bool HasMaxKey;
+    uint64_t RowsImported;
+    uint64_t RowsUncounted; // * Appended since the file header's row count was last updated
+    uint64_t Duplicates;
+    uint64_t Malformed;
+    bool TableFull; // * Ends the import; rows after the one that did not fit are not read
+} BulkLoader;
+
+void BulkLoaderRelease(BulkLoader* loader) {
+    if (loader->Page != NULL) {
+        UnpinPage(loader->Table->Pager, loader->PageNum);
+        loader->Page = NULL;
+    }
+}
+
+// * Counts the appended rows into the file header and commits them with it
+void BulkLoaderCommit(BulkLoader* loader) {
+    if (loader->RowsUncounted > 0) {
+        TableAddRows(loader->Table, loader->RowsUncounted);
+        loader->RowsUncounted = 0;
+    }
+    CommitPager(loader->Table->Pager);
+}
+
+// * Hands the full rightmost leaf to its parent and starts a fresh one after it
+void BulkLoaderSeal(BulkLoader* loader) {
+    Table* table = loader->Table;
+    // * Worst case every level above the leaf splits and the root needs one more page
+    if ((uint64_t)GetUnusedPageNum(table->Pager) + loader->Depth + 2 > table->MaxPages) {
+        loader->TableFull = true;
+        return;
+    }
+    uint32_t newPageNum = AllocatePage(table);
+    void* newNode = GetPage(table->Pager, newPageNum);
+    InitializeLeafNode(newNode);
+    *LeafNodeNextLeaf(loader->Page) = newPageNum;
+    MarkPageDirty(table->Pager, newPageNum);
+    MarkPageDirty(table->Pager, loader->PageNum);
+    UnpinPage(table->Pager, newPageNum);
+    BulkLoaderRelease(loader);
+
+    // * The leaf is the right child of the last level, so the parent gains it
+    // * as its last cell and takes the new leaf as right child
+    InternalNodeInsert(table, loader->PathPages, loader->PathChildren, loader->Depth, loader->PageNum, loader->MaxKey, newPageNum);
+    if (table->Pager->NumPendingPages >= IMPORT_MAX_PENDING_PAGES) {
+        BulkLoaderCommit(loader);
+    }
+}
+
+void BulkLoaderAppend(BulkLoader* loader, uint32_t identifier, const char* username, size_t usernameLength, const char* email, size_t emailLength) {
+    Table* table = loader->Table;
+
+    if (loader->Page == NULL) {
+        // * Imports run from the shell with the write lock held and nothing
+        // * else reading, so the loader skips latching its pages
+        uint32_t latchedDepth;
+        loader->PageNum = TableDescend(table, UINT32_MAX, LATCH_NONE, loader->PathPages, loader->PathChildren, &loader->Depth, &latchedDepth, &loader->Page, NULL);
+        uint32_t numCells = *LeafNodeNumCells(loader->Page);
+        if (numCells > 0) {
+            loader->MaxKey = *LeafNodeKey(loader->Page, numCells - 1);
+            loader->HasMaxKey = true;
+        }
+    }
+
+    if (loader->HasMaxKey && identifier <= loader->MaxKey) {
+        // * Out of order. Fall back to a regular insert and descend again later.
+        BulkLoaderRelease(loader);
+        RowFields row;
+        row.ID = identifier;
+        row.Username = username;
+        row.UsernameLength = usernameLength;
+        row.Email = email;
+        row.EmailLength = emailLength;
+
+        bool inserted;
+        uint32_t numConsumed;
+        if (TableInsert(table, &row, 1, &inserted, &numConsumed) == EXECUTE_TABLE_FULL) {
+            loader->TableFull = true;
+        } else if (inserted) {
+            IndexInsertRow(table, identifier, username, usernameLength, email, emailLength);
+            loader->RowsImported += 1;
+        } else {
+            loader->Duplicates += 1;
+        }
+        if (table->Pager->NumPendingPages >= IMPORT_MAX_PENDING_PAGES) {
+            BulkLoaderCommit(loader);
+        }
+        return;
+    }
+
+    // * Fields go from the input buffer straight into the cell
+    uint8_t cell[LEAF_NODE_MAX_CELL_SIZE];
+    uint32_t length = SerializeRowFields(cell, username, usernameLength, email, emailLength);
+    if (!LeafNodeInsertCell(loader->Page, *LeafNodeNumCells(loader->Page), identifier, cell, length)) {
+        BulkLoaderSeal(loader);
+        if (!loader->TableFull) {
+            BulkLoaderAppend(loader, identifier, username, usernameLength, email, emailLength);
+        }
+        return;
+    }
+    MarkPageDirty(table->Pager, loader->PageNum);
+    IndexInsertRow(table, identifier, username, usernameLength, email, emailLength);
+
+    loader->MaxKey = identifier;
+    loader->HasMaxKey = true;
+    loader->RowsImported += 1;
+    loader->RowsUncounted += 1;
+    // * Index pages are dirtied row by row, so they may fill the batch before the leaf does
+    if (table->Pager->NumPendingPages >= IMPORT_MAX_PENDING_PAGES) {
+        BulkLoaderCommit(loader);
+    }
+}
+
+// * Cuts the field at *cursor out of a record ending at end, undoing RFC 4180
+// * quoting in place: a field in double quotes may hold commas, line breaks
+// * and quotes written as "". Leaves *cursor on the comma after the field, or
+// * at end. Returns false for an unterminated quoted field, text after its
+// * closing quote, or a quote inside an unquoted field.
+bool CsvField(char** cursor, char* end, char** field, size_t* length) {
+    char* position = *cursor;
+    *field = position;
+    if (position < end && *position == '"') {
+        char* output = position;
+        position += 1;
+        while (true) {
+            if (position == end) {
+                return false;
+            }
+            if (*position == '"') {
+                if (position + 1 < end && position[1] == '"') {
+                    *output++ = '"';
+                    position += 2;
+                    continue;
+                }
+                position += 1;
+                break;
+            }
+            *output++ = *position++;
+        }
+        if (position < end && *position != ',') {
+            return false;
+        }
+        *length = output - *field;
+    } else {
+        char* comma = memchr(position, ',', end - position);
+        position = comma != NULL ? comma : end;
+        *length = position - *field;
+        if (memchr(*field, '"', *length) != NULL) {
+            return false;
+        }
+    }
+    *cursor = position;
+    return true;
+}
+
+// * Parses one "id,username,email" record in place. Fields may be quoted as
+// * CSV output writes them. Returns false if it is malformed.
+bool BulkLoaderLine(BulkLoader* loader, char* line, size_t length) {
+    if (length > 0 && line[length - 1] == '\r') {
+        length -= 1;
+    }
+
+    char* end = line + length;
+    char* cursor = line;
+    char *identifierField, *username, *email;
+    size_t identifierLength, usernameLength, emailLength;
+    if (!CsvField(&cursor, end, &identifierField, &identifierLength) || cursor == end) {
+        return false;
+    }
+    cursor += 1;
+    if (!CsvField(&cursor, end, &username, &usernameLength) || cursor == end) {
+        return false;
+    }
+    cursor += 1;
+    if (!CsvField(&cursor, end, &email, &emailLength) || cursor != end) {
+        return false;
+    }
+
+    if (identifierLength == 0) {
+        return false;
+    }
+    uint64_t identifier = 0;
+    for (size_t i = 0; i < identifierLength; i++) {
+        if (identifierField[i] < '0' || identifierField[i] > '9') {
+            return false;
+        }
+        identifier = identifier * 10 + (identifierField[i] - '0');
+        if (identifier > UINT32_MAX) {
+            return false;
+        }
+    }
+    // * Limits apply to the values, not their quoted form
+    if (usernameLength == 0 || usernameLength > COLUMN_USERNAME_SIZE || emailLength == 0 || emailLength > COLUMN_EMAIL_SIZE) {
+        return false;
+    }
+
+    BulkLoaderAppend(loader, (uint32_t)identifier, username, usernameLength, email, emailLength);
+    return true;
+}
+
+// * Finds the newline ending the record at line, skipping newlines inside
+// * quoted fields: those follow an odd number of quotes in the record.
+char* CsvRecordEnd(char* line, char* limit) {
+    char* newline = memchr(line, '\n', limit - line);
+    while (newline != NULL) {
+        uint32_t quotes = 0;
+        for (char* quote = memchr(line, '"', newline - line); quote != NULL; quote = memchr(quote + 1, '"', newline - quote - 1)) {
+            quotes += 1;
+        }
+        if (quotes % 2 == 0) {
+            return newline;
+        }
+        newline = memchr(newline + 1, '\n', limit - newline - 1);
+    }
+    return NULL;
+}
+
+// * Streams a CSV file of "id,username,email" records into the table through one
+// * large read buffer. A first line that does not start with a digit is taken
+// * as a header and skipped. Prints one summary line instead of per-row output.
+void ImportCSV(Table* table, const char* path) {
+    int fileDescriptor = open(path, O_RDONLY);
+    if (fileDescriptor == -1) {
+        printf("Unable to open import file '%s'.\n", path);
+        return;
+    }
+    posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct timespec startedAt;
+    clock_gettime(CLOCK_MONOTONIC, &startedAt);
+
+    BulkLoader loader;
+    memset(&loader, 0, sizeof(loader));
+    loader.Table = table;
+    pthread_mutex_lock(&table->WriteLock);
+    PagerAdvise(table->Pager, PAGER_ACCESS_SEQUENTIAL);
+
+    char* buffer = malloc(IMPORT_BUFFER_SIZE);
+    size_t buffered = 0;
+    uint64_t bytesTotal = 0;
+    uint64_t lineNumber = 0;
+    bool endOfFile = false;
+
+    while (!endOfFile) {
+        ssize_t bytesRead = read(fileDescriptor, buffer + buffered, IMPORT_BUFFER_SIZE - buffered);
+        if (bytesRead == -1) {
+            printf("Error reading import file: %d\n", errno);
+            break;
+        }
+        if (bytesRead == 0) {
+            endOfFile = true;
+            if (buffered > 0 && buffer[buffered - 1] != '\n') {
+                buffer[buffered++] = '\n'; // * Terminate a last line without newline
+            }
+        }
+        buffered += bytesRead;
+        bytesTotal += bytesRead;
+
+        char* line = buffer;
+        char* limit = buffer + buffered;
+        char* newline;
+        while (!loader.TableFull && (newline = CsvRecordEnd(line, limit)) != NULL) {
+            size_t length = newline - line;
+            lineNumber += 1;
+            if (length > 0 && !(lineNumber == 1 && (line[0] < '0' || line[0] > '9'))) {
+                if (!BulkLoaderLine(&loader, line, length)) {
+                    loader.Malformed += 1;
+                }
+            }
+            line = newline + 1;
+        }
+
+        if (loader.TableFull) {
+            printf("Error: Table full.\n");
+            break;
+        }
+
+        // * Keep the partial last line for the next read
+        buffered = limit - line;
+        memmove(buffer, line, buffered);
+        if (buffered == IMPORT_BUFFER_SIZE) {
+            printf("Line %llu of import file is longer than %d bytes.\n", (unsigned long long)lineNumber + 1, IMPORT_BUFFER_SIZE);
+            break;
+        }
+    }
+    if (endOfFile && buffered > 0 && !loader.TableFull) {
+        loader.Malformed += 1; // * A quoted field never closed
+    }
+
+    BulkLoaderRelease(&loader);
+    BulkLoaderCommit(&loader);
+    pthread_mutex_unlock(&table->WriteLock);
+    free(buffer);
+    close(fileDescriptor);
+
+    double seconds = ElapsedMs(&startedAt) / 1000.0;
+    if (seconds <= 0) {
+        seconds = 0.001;
+    }
+    printf("Imported %llu rows (%llu duplicate, %llu malformed) in %.3f s: %.0f rows/s, %.1f MB/s.\n",
+        (unsigned long long)loader.RowsImported, (unsigned long long)loader.Duplicates, (unsigned long long)loader.Malformed,
+        seconds, loader.RowsImported / seconds, bytesTotal / seconds / (1024 * 1024));
+}
@@ -0,0 +1,479 @@
+#include "index.h"
+
+#include <string.h>
+
+uint32_t* CatalogIndexPage(void* catalog, EIndexColumn column) {
+    return catalog + column * CATALOG_INDEX_PAGE_SIZE;
+}
+
+uint32_t* IndexLevel(void* header) {
+    return header + INDEX_LEVEL_OFFSET;
+}
+
+uint32_t* IndexSplitBucket(void* header) {
+    return header + INDEX_SPLIT_BUCKET_OFFSET;
+}
+
+uint32_t* IndexNumEntries(void* header) {
+    return header + INDEX_NUM_ENTRIES_OFFSET;
+}
+
+uint32_t* IndexSplitReadPage(void* header) {
+    return header + INDEX_SPLIT_READ_PAGE_OFFSET;
+}
+
+uint32_t* IndexSplitWritePage(void* header) {
+    return header + INDEX_SPLIT_WRITE_PAGE_OFFSET;
+}
+
+uint32_t* IndexSplitNewTail(void* header) {
+    return header + INDEX_SPLIT_NEW_TAIL_OFFSET;
+}
+
+uint32_t* IndexMapPage(void* header, uint32_t mapNum) {
+    return header + INDEX_MAP_PAGES_OFFSET + mapNum * sizeof(uint32_t);
+}
+
+uint32_t* BucketNumEntries(void* page) {
+    return page + INDEX_BUCKET_NUM_ENTRIES_OFFSET;
+}
+
+uint32_t* BucketNextOverflow(void* page) {
+    return page + INDEX_BUCKET_NEXT_OVERFLOW_OFFSET;
+}
+
+uint32_t* BucketEntryHash(void* page, uint32_t entryNum) {
+    return page + INDEX_BUCKET_HEADER_SIZE + entryNum * INDEX_ENTRY_SIZE + INDEX_ENTRY_HASH_OFFSET;
+}
+
+uint32_t* BucketEntryKey(void* page, uint32_t entryNum) {
+    return page + INDEX_BUCKET_HEADER_SIZE + entryNum * INDEX_ENTRY_SIZE + INDEX_ENTRY_KEY_OFFSET;
+}
+
+uint32_t IndexNumBuckets(void* header) {
+    return (1u << *IndexLevel(header)) + *IndexSplitBucket(header);
+}
+
+// * FNV-1a, then a final mix so the low bits that pick the bucket depend on
+// * every byte of the value
+uint32_t IndexHash(const char* value, uint32_t length) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)value[i];
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+uint32_t IndexBucketFor(void* header, uint32_t hash) {
+    uint32_t level = *IndexLevel(header);
+    uint32_t bucket = hash & ((1u << level) - 1);
+    if (bucket < *IndexSplitBucket(header)) {
+        bucket = hash & ((2u << level) - 1);
+    }
+    return bucket;
+}
+
+// * Returns a zeroed page, pinned and marked dirty
+void* IndexAllocatePage(Table* table, uint32_t* pageNum) {
+    Pager* pager = table->Pager;
+    *pageNum = AllocatePage(table);
+    void* page = GetPage(pager, *pageNum);
+    memset(page, 0, PAGE_SIZE);
+    MarkPageDirty(pager, *pageNum);
+    return page;
+}
+
+uint32_t IndexBucketPage(Pager* pager, void* header, uint32_t bucket) {
+    uint32_t mapPageNum = *IndexMapPage(header, bucket / INDEX_MAP_ENTRIES);
+    uint32_t* map = GetPage(pager, mapPageNum);
+    uint32_t pageNum = map[bucket % INDEX_MAP_ENTRIES];
+    UnpinPage(pager, mapPageNum);
+    return pageNum;
+}
+
+// * Records the first page of a new bucket, starting a map page when the last is full
+void IndexSetBucketPage(Table* table, void* header, uint32_t bucket, uint32_t pageNum) {
+    Pager* pager = table->Pager;
+    uint32_t mapNum = bucket / INDEX_MAP_ENTRIES;
+    uint32_t mapPageNum = *IndexMapPage(header, mapNum);
+    uint32_t* map;
+    if (mapPageNum == 0) {
+        map = IndexAllocatePage(table, &mapPageNum);
+        *IndexMapPage(header, mapNum) = mapPageNum;
+    } else {
+        map = GetPage(pager, mapPageNum);
+        MarkPageDirty(pager, mapPageNum);
+    }
+    map[bucket % INDEX_MAP_ENTRIES] = pageNum;
+    UnpinPage(pager, mapPageNum);
+}
+
+// * Adds an entry to the last page of a chain, chaining a new overflow page
+// * if it is full. Returns the chain's last page afterwards.
+uint32_t IndexAppendAt(Table* table, uint32_t pageNum, uint32_t hash, uint32_t key) {
+    Pager* pager = table->Pager;
+    void* page = GetPage(pager, pageNum);
+    if (*BucketNumEntries(page) == INDEX_BUCKET_MAX_ENTRIES) {
+        uint32_t overflowPageNum;
+        void* overflow = IndexAllocatePage(table, &overflowPageNum);
+        *BucketNextOverflow(page) = overflowPageNum;
+        MarkPageDirty(pager, pageNum);
+        UnpinPage(pager, pageNum);
+        pageNum = overflowPageNum;
+        page = overflow;
+    }
+
+    uint32_t entryNum = *BucketNumEntries(page);
+    *BucketEntryHash(page, entryNum) = hash;
+    *BucketEntryKey(page, entryNum) = key;
+    *BucketNumEntries(page) = entryNum + 1;
+    MarkPageDirty(pager, pageNum);
+    UnpinPage(pager, pageNum);
+    return pageNum;
+}
+
+// * Adds an entry to the last page of a bucket's chain
+void IndexAppend(Table* table, uint32_t bucketPageNum, uint32_t hash, uint32_t key) {
+    Pager* pager = table->Pager;
+    uint32_t pageNum = bucketPageNum;
+    void* page = GetPage(pager, pageNum);
+    while (*BucketNextOverflow(page) != 0) {
+        uint32_t nextPageNum = *BucketNextOverflow(page);
+        UnpinPage(pager, pageNum);
+        pageNum = nextPageNum;
+        page = GetPage(pager, pageNum);
+    }
+    UnpinPage(pager, pageNum);
+    IndexAppendAt(table, pageNum, hash, key);
+}
+
+// * Starts splitting bucket SplitBucket into itself and a new, empty bucket
+// * 2^Level above it. The new bucket only counts once the split is done.
+void IndexStartSplit(Table* table, void* header) {
+    Pager* pager = table->Pager;
+    uint32_t level = *IndexLevel(header);
+    uint32_t oldBucket = *IndexSplitBucket(header);
+    uint32_t oldPageNum = IndexBucketPage(pager, header, oldBucket);
+
+    uint32_t newPageNum;
+    IndexAllocatePage(table, &newPageNum);
+    UnpinPage(pager, newPageNum);
+    IndexSetBucketPage(table, header, oldBucket + (1u << level), newPageNum);
+    *IndexSplitReadPage(header) = oldPageNum;
+    *IndexSplitWritePage(header) = oldPageNum;
+    *IndexSplitNewTail(header) = newPageNum;
+}
+
+// * Redistributes the next page of the splitting chain: entries whose hash
+// * has bit Level set go to the new bucket, the rest are packed behind the
+// * ones already kept. A page left empty is unlinked and freed. The chain's
+// * first page always stays. Once its last page is done the split ends.
+void IndexSplitStep(Table* table, void* header) {
+    Pager* pager = table->Pager;
+    uint32_t level = *IndexLevel(header);
+    uint32_t readPageNum = *IndexSplitReadPage(header);
+    uint32_t hashes[INDEX_BUCKET_MAX_ENTRIES];
+    uint32_t keys[INDEX_BUCKET_MAX_ENTRIES];
+
+    void* readPage = GetPage(pager, readPageNum);
+    uint32_t count = *BucketNumEntries(readPage);
+    for (uint32_t i = 0; i < count; i++) {
+        hashes[i] = *BucketEntryHash(readPage, i);
+        keys[i] = *BucketEntryKey(readPage, i);
+    }
+    uint32_t nextPageNum = *BucketNextOverflow(readPage);
+    *BucketNumEntries(readPage) = 0;
+    MarkPageDirty(pager, readPageNum);
+    UnpinPage(pager, readPageNum);
+
+    // * The write page is the read page or the one linked right before it,
+    // * and never holds more kept entries than have been read
+    uint32_t writePageNum = *IndexSplitWritePage(header);
+    uint32_t newTail = *IndexSplitNewTail(header);
+    void* writePage = GetPage(pager, writePageNum);
+    for (uint32_t i = 0; i < count; i++) {
+        if ((hashes[i] >> level) & 1) {
+            newTail = IndexAppendAt(table, newTail, hashes[i], keys[i]);
+            continue;
+        }
+        if (*BucketNumEntries(writePage) == INDEX_BUCKET_MAX_ENTRIES) {
+            MarkPageDirty(pager, writePageNum);
+            UnpinPage(pager, writePageNum);
+            writePageNum = *BucketNextOverflow(writePage);
+            writePage = GetPage(pager, writePageNum);
+        }
+        uint32_t entryNum = *BucketNumEntries(writePage);
+        *BucketEntryHash(writePage, entryNum) = hashes[i];
+        *BucketEntryKey(writePage, entryNum) = keys[i];
+        *BucketNumEntries(writePage) = entryNum + 1;
+    }
+    if (writePageNum != readPageNum) {
+        *BucketNextOverflow(writePage) = nextPageNum;
+    }
+    MarkPageDirty(pager, writePageNum);
+    UnpinPage(pager, writePageNum);
+    if (writePageNum != readPageNum) {
+        FreePage(table, readPageNum);
+    }
+
+    *IndexSplitReadPage(header) = nextPageNum;
+    *IndexSplitWritePage(header) = writePageNum;
+    *IndexSplitNewTail(header) = newTail;
+    if (nextPageNum != 0) {
+        return;
+    }
+
+    uint32_t oldBucket = *IndexSplitBucket(header);
+    *IndexSplitWritePage(header) = 0;
+    *IndexSplitNewTail(header) = 0;
+    if (oldBucket + 1 == 1u << level) {
+        *IndexLevel(header) = level + 1;
+        *IndexSplitBucket(header) = 0;
+    } else {
+        *IndexSplitBucket(header) = oldBucket + 1;
+    }
+}
+
+void IndexInsert(Table* table, uint32_t headerPageNum, uint32_t hash, uint32_t key) {
+    Pager* pager = table->Pager;
+    LatchPage(pager, headerPageNum, LATCH_EXCLUSIVE);
+    void* header = GetPage(pager, headerPageNum);
+    IndexAppend(table, IndexBucketPage(pager, header, IndexBucketFor(header, hash)), hash, key);
+    *IndexNumEntries(header) += 1;
+
+    uint32_t numBuckets = IndexNumBuckets(header);
+    if (*IndexSplitReadPage(header) != 0) {
+        IndexSplitStep(table, header);
+    } else if ((uint64_t)*IndexNumEntries(header) * 100 > (uint64_t)numBuckets * INDEX_BUCKET_MAX_ENTRIES * INDEX_LOAD_PERCENT && numBuckets < INDEX_MAX_BUCKETS) {
+        IndexStartSplit(table, header);
+        IndexSplitStep(table, header);
+    }
+    MarkPageDirty(pager, headerPageNum);
+    UnpinPage(pager, headerPageNum);
+    UnlatchPage(pager, headerPageNum);
+}
+
+// * Loads the index header pages named in the catalog, if there is one
+void OpenIndexes(Table* table) {
+    Pager* pager = table->Pager;
+    memset(table->IndexPages, 0, sizeof(table->IndexPages));
+
+    void* fileHeader = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    uint32_t catalogPageNum = *FileCatalogPage(fileHeader);
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+    if (catalogPageNum == 0) {
+        return;
+    }
+
+    void* catalog = GetPage(pager, catalogPageNum);
+    for (uint32_t i = 0; i < TABLE_MAX_INDEXES; i++) {
+        table->IndexPages[i] = *CatalogIndexPage(catalog, i);
+    }
+    UnpinPage(pager, catalogPageNum);
+}
+
+// * Writes the entries of a new index bucket by bucket, sized up front so no
+// * bucket needs splitting, so each page is written and logged once. Does not
+// * commit: an index larger than the pool spills to the log instead, so the
+// * whole build lands in CreateIndex's one COMMIT.
+void IndexBulkLoad(Table* table, uint32_t headerPageNum, uint32_t* hashes, uint32_t* keys, uint32_t numEntries) {
+    Pager* pager = table->Pager;
+    uint64_t perBucket = (uint64_t)INDEX_BUCKET_MAX_ENTRIES * INDEX_LOAD_PERCENT / 100;
+    uint64_t wanted = (numEntries + perBucket - 1) / perBucket;
+    uint32_t numBuckets = wanted < 1 ? 1 : wanted > INDEX_MAX_BUCKETS ? INDEX_MAX_BUCKETS : (uint32_t)wanted;
+    uint32_t level = 0;
+    while (2u << level <= numBuckets) {
+        level++;
+    }
+
+    void* header = GetPage(pager, headerPageNum);
+    *IndexLevel(header) = level;
+    *IndexSplitBucket(header) = numBuckets - (1u << level);
+    *IndexNumEntries(header) = numEntries;
+
+    // * Counting sort of the entries by bucket
+    uint32_t* starts = calloc(numBuckets + 1, sizeof(uint32_t));
+    uint32_t* buckets = malloc(numEntries * sizeof(uint32_t) + 1);
+    for (uint32_t i = 0; i < numEntries; i++) {
+        buckets[i] = IndexBucketFor(header, hashes[i]);
+        starts[buckets[i] + 1] += 1;
+    }
+    for (uint32_t b = 0; b < numBuckets; b++) {
+        starts[b + 1] += starts[b];
+    }
+    uint32_t* order = malloc(numEntries * sizeof(uint32_t) + 1);
+    uint32_t* next = malloc(numBuckets * sizeof(uint32_t));
+    memcpy(next, starts, numBuckets * sizeof(uint32_t));
+    for (uint32_t i = 0; i < numEntries; i++) {
+        order[next[buckets[i]]++] = i;
+    }
+
+    for (uint32_t b = 0; b < numBuckets; b++) {
+        uint32_t pageNum;
+        void* page = IndexAllocatePage(table, &pageNum);
+        IndexSetBucketPage(table, header, b, pageNum);
+        for (uint32_t j = starts[b]; j < starts[b + 1]; j++) {
+            if (*BucketNumEntries(page) == INDEX_BUCKET_MAX_ENTRIES) {
+                uint32_t overflowPageNum;
+                void* overflow = IndexAllocatePage(table, &overflowPageNum);
+                *BucketNextOverflow(page) = overflowPageNum;
+                UnpinPage(pager, pageNum);
+                pageNum = overflowPageNum;
+                page = overflow;
+            }
+            uint32_t entryNum = *BucketNumEntries(page);
+            *BucketEntryHash(page, entryNum) = hashes[order[j]];
+            *BucketEntryKey(page, entryNum) = keys[order[j]];
+            *BucketNumEntries(page) = entryNum + 1;
+        }
+        UnpinPage(pager, pageNum);
+    }
+    MarkPageDirty(pager, headerPageNum);
+    UnpinPage(pager, headerPageNum);
+
+    free(starts);
+    free(buckets);
+    free(order);
+    free(next);
+}
+
+// * Builds a hash index over the rows already in the table, then records it
+// * in the catalog, all in one commit: a crash part way through loses the
+// * build whole rather than leaving pages nothing points to. Readers and
+// * writers only start using the index once it is complete.
+EExecuteResult CreateIndex(Table* table, EIndexColumn column) {
+    Pager* pager = table->Pager;
+    pthread_mutex_lock(&table->WriteLock);
+    if (table->IndexPages[column] != 0) {
+        pthread_mutex_unlock(&table->WriteLock);
+        return EXECUTE_INDEX_EXISTS;
+    }
+    PagerAdvise(pager, PAGER_ACCESS_SEQUENTIAL);
+
+    uint32_t capacity = INDEX_BUCKET_MAX_ENTRIES;
+    uint32_t numEntries = 0;
+    uint32_t* hashes = malloc(capacity * sizeof(uint32_t));
+    uint32_t* keys = malloc(capacity * sizeof(uint32_t));
+    Cursor* cursor = TableStart(table);
+    while (!(cursor->EndOfTable)) {
+        if (numEntries == capacity) {
+            capacity *= 2;
+            hashes = realloc(hashes, capacity * sizeof(uint32_t));
+            keys = realloc(keys, capacity * sizeof(uint32_t));
+        }
+        const char *username, *email;
+        uint32_t usernameLength, emailLength;
+        CellFields(CursorValue(cursor), &username, &usernameLength, &email, &emailLength);
+        hashes[numEntries] = column == INDEX_USERNAME ? IndexHash(username, usernameLength) : IndexHash(email, emailLength);
+        keys[numEntries] = CursorKey(cursor);
+        numEntries++;
+        CursorAdvance(cursor);
+    }
+    CloseCursor(cursor);
+
+    uint32_t headerPageNum;
+    IndexAllocatePage(table, &headerPageNum);
+    UnpinPage(pager, headerPageNum);
+    IndexBulkLoad(table, headerPageNum, hashes, keys, numEntries);
+    free(hashes);
+    free(keys);
+
+    // * Only writers read the file header once the table is open
+    void* fileHeader = GetPage(pager, FILE_HEADER_PAGE_NUM);
+    uint32_t catalogPageNum = *FileCatalogPage(fileHeader);
+    void* catalog;
+    if (catalogPageNum == 0) {
+        catalog = IndexAllocatePage(table, &catalogPageNum);
+        *FileCatalogPage(fileHeader) = catalogPageNum;
+        MarkPageDirty(pager, FILE_HEADER_PAGE_NUM);
+    } else {
+        catalog = GetPage(pager, catalogPageNum);
+    }
+    UnpinPage(pager, FILE_HEADER_PAGE_NUM);
+
+    *CatalogIndexPage(catalog, column) = headerPageNum;
+    MarkPageDirty(pager, catalogPageNum);
+    UnpinPage(pager, catalogPageNum);
+    CommitPager(pager);
+
+    __atomic_store_n(&table->IndexPages[column], headerPageNum, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&table->WriteLock);
+    return EXECUTE_SUCCESS;
+}
+
+// * Adds a newly inserted row to every index. Callers hold the table's WriteLock.
+void IndexInsertRow(Table* table, uint32_t key, const char* username, uint32_t usernameLength, const char* email, uint32_t emailLength) {
+    uint32_t usernamePageNum = __atomic_load_n(&table->IndexPages[INDEX_USERNAME], __ATOMIC_ACQUIRE);
+    uint32_t emailPageNum = __atomic_load_n(&table->IndexPages[INDEX_EMAIL], __ATOMIC_ACQUIRE);
+    if (usernamePageNum != 0) {
+        IndexInsert(table, usernamePageNum, IndexHash(username, usernameLength), key);
+    }
+    if (emailPageNum != 0) {
+        IndexInsert(table, emailPageNum, IndexHash(email, emailLength), key);
+    }
+}
+
+int CompareKeys(const void* left, const void* right) {
+    uint32_t a = *(const uint32_t*)left;
+    uint32_t b = *(const uint32_t*)right;
+    return (a > b) - (a < b);
+}
+
+// * Returns false if the column has no index. Otherwise returns, in a malloc'd
+// * *keys sorted ascending, the IDs in [keyFrom, keyTo] of every row whose
+// * value may equal the given one. Hash collisions are included; callers
+// * compare the rows themselves.
+bool IndexLookup(Table* table, EIndexColumn column, const char* value, uint32_t length, uint32_t keyFrom, uint32_t keyTo, uint32_t** keys, uint32_t* numKeys) {
+    Pager* pager = table->Pager;
+    uint32_t headerPageNum = __atomic_load_n(&table->IndexPages[column], __ATOMIC_ACQUIRE);
+    if (headerPageNum == 0) {
+        return false;
+    }
+    uint32_t hash = IndexHash(value, length);
+
+    LatchPage(pager, headerPageNum, LATCH_SHARED);
+    void* header = GetPage(pager, headerPageNum);
+    uint32_t bucket = IndexBucketFor(header, hash);
+    uint32_t pageNum = IndexBucketPage(pager, header, bucket);
+    // * Entries of a bucket being split may already be in the new one
+    uint32_t splitPageNum = 0;
+    if (*IndexSplitReadPage(header) != 0 && bucket == *IndexSplitBucket(header)) {
+        splitPageNum = IndexBucketPage(pager, header, bucket + (1u << *IndexLevel(header)));
+    }
+    uint32_t capacity = 16;
+    *keys = malloc(capacity * sizeof(uint32_t));
+    *numKeys = 0;
+    while (pageNum != 0) {
+        void* page = GetPage(pager, pageNum);
+        uint32_t count = *BucketNumEntries(page);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t key = *BucketEntryKey(page, i);
+            if (*BucketEntryHash(page, i) != hash || key < keyFrom || key > keyTo) {
+                continue;
+            }
+            if (*numKeys == capacity) {
+                capacity *= 2;
+                *keys = realloc(*keys, capacity * sizeof(uint32_t));
+            }
+            (*keys)[(*numKeys)++] = key;
+        }
+        uint32_t nextPageNum = *BucketNextOverflow(page);
+        UnpinPage(pager, pageNum);
+        pageNum = nextPageNum;
+        if (pageNum == 0) {
+            pageNum = splitPageNum;
+            splitPageNum = 0;
+        }
+    }
+    UnpinPage(pager, headerPageNum);
+    UnlatchPage(pager, headerPageNum);
+
+    qsort(*keys, *numKeys, sizeof(uint32_t), CompareKeys);
+    return true;
+}
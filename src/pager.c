@@ -0,0 +1,1500 @@
+#include "pager.h"
+#include "checksum.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+uint32_t WalRecordChecksum(WalRecordHeader* header, const void* payload, size_t payloadLength) {
+    WalRecordHeader copy = *header;
+    copy.Checksum = 0;
+    uint32_t checksum = Crc32c(0, &copy, sizeof(copy));
+    return Crc32c(checksum, payload, payloadLength);
+}
+
+typedef enum {
+    PAGE_CHECK_VALID,
+    PAGE_CHECK_UNUSED,
+    PAGE_CHECK_CORRUPT
+} EPageCheck;
+
+// * One .verify, shared by the threads checking the file
+typedef struct {
+    Pager* Pager;
+    uint32_t NumPages;
+    uint32_t NextChunk; // * Updated atomically
+    uint32_t NumCorrupt; // * Updated atomically
+    uint32_t NumUnused; // * Updated atomically
+} PagerVerification;
+
+void StampPageChecksum(void* page) {
+    uint32_t checksum = Crc32c(0, page, PAGE_CHECKSUM_OFFSET);
+    memcpy(page + PAGE_CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+}
+
+EPageCheck CheckPage(const void* page) {
+    uint32_t checksum;
+    memcpy(&checksum, page + PAGE_CHECKSUM_OFFSET, sizeof(checksum));
+    if (Crc32c(0, page, PAGE_CHECKSUM_OFFSET) == checksum) {
+        return PAGE_CHECK_VALID;
+    }
+    const uint64_t* words = page;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i] != 0) {
+            return PAGE_CHECK_CORRUPT;
+        }
+    }
+    return PAGE_CHECK_UNUSED;
+}
+
+// * A page the tree asked for must have been written, so an unused one is corrupt too
+void CheckRequestedPage(const void* page, uint32_t pageNum) {
+    if (CheckPage(page) != PAGE_CHECK_VALID) {
+        printf("Page %d failed its checksum. Corrupt file.\n", pageNum);
+        exit(EXIT_FAILURE);
+    }
+}
+
+ssize_t ReadFully(int fileDescriptor, void* buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t bytesRead = read(fileDescriptor, buffer + total, length - total);
+        if (bytesRead == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        total += bytesRead;
+    }
+    return total;
+}
+
+// * Reads consecutive pages at offset into the buffers of vectors, retrying
+// * short reads. Returns the bytes read, less than asked only at end of file.
+size_t ReadPagesAt(int fileDescriptor, struct iovec* vectors, int count, off_t offset) {
+    size_t total = 0;
+    while (count > 0) {
+        ssize_t bytesRead = preadv(fileDescriptor, vectors, count, offset + total);
+        if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead == -1) {
+            printf("Error reading file: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        total += bytesRead;
+        while (count > 0 && (size_t)bytesRead >= vectors->iov_len) {
+            bytesRead -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0) {
+            vectors->iov_base += bytesRead;
+            vectors->iov_len -= bytesRead;
+        }
+    }
+    return total;
+}
+
+uint64_t ElapsedMs(struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+Wal* OpenWal(const char* filename, const DBOptions* options) {
+    Wal* wal = malloc(sizeof(Wal));
+    wal->Filename = malloc(strlen(filename) + sizeof("-wal"));
+    strcpy(wal->Filename, filename);
+    strcat(wal->Filename, "-wal");
+
+    wal->FileDescriptor = open(wal->Filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+    if (wal->FileDescriptor == -1) {
+        printf("Unable to open write-ahead log\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&wal->Lock, NULL);
+    wal->FileLength = lseek(wal->FileDescriptor, 0, SEEK_END);
+    wal->NextSequence = 1;
+    wal->UnsyncedCommits = 0;
+    wal->CommitBatch = options->CommitBatch;
+    wal->CommitIntervalMs = options->CommitIntervalMs;
+    wal->CheckpointBytes = (off_t)options->CheckpointMB * 1024 * 1024;
+    wal->Stopping = false;
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&wal->SyncerWake, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    return wal;
+}
+
+// * Callers hold wal->Lock
+void WalSync(Wal* wal) {
+    if (wal->UnsyncedCommits == 0) {
+        return;
+    }
+    uint64_t startedAt = StatsNow();
+    if (fdatasync(wal->FileDescriptor) == -1) {
+        printf("Error syncing write-ahead log: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    StatsRecord(STATS_WAL_SYNC, startedAt);
+    Stats.WalSyncs += 1;
+    wal->UnsyncedCommits = 0;
+}
+
+// * Appends the vectors to the log in order, at most IOV_MAX per writev and
+// * resuming after short writes, so a batch of any size lands whole and
+// * whatever ends it is written last. Consumes the vectors. Callers hold
+// * wal->Lock.
+size_t WalWrite(Wal* wal, struct iovec* vectors, size_t count) {
+    size_t total = 0;
+    while (count > 0) {
+        ssize_t bytesWritten = writev(wal->FileDescriptor, vectors, count < IOV_MAX ? (int)count : IOV_MAX);
+        if (bytesWritten == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesWritten <= 0) {
+            printf("Error writing write-ahead log: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        total += bytesWritten;
+        size_t remaining = bytesWritten;
+        while (count > 0 && remaining >= vectors->iov_len) {
+            remaining -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (remaining > 0) {
+            vectors->iov_base = (char*)vectors->iov_base + remaining;
+            vectors->iov_len -= remaining;
+        }
+    }
+    wal->FileLength += total;
+    Stats.WalBytesWritten += total;
+    return total;
+}
+
+void WalTruncate(Wal* wal) {
+    if (ftruncate(wal->FileDescriptor, 0) == -1 || lseek(wal->FileDescriptor, 0, SEEK_SET) == -1) {
+        printf("Error truncating write-ahead log: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    fsync(wal->FileDescriptor);
+    wal->FileLength = 0;
+    wal->NextSequence = 1;
+    wal->UnsyncedCommits = 0;
+}
+
+// * Replays every committed statement in the log straight into the database
+// * file. A torn or corrupt tail ends the replay; whatever follows the last
+// * intact COMMIT never reached the user as durable.
+void RecoverWal(Wal* wal, int dbFileDescriptor) {
+    if (wal->FileLength == 0) {
+        return;
+    }
+
+    lseek(wal->FileDescriptor, 0, SEEK_SET);
+
+    uint32_t capacity = 16;
+    uint32_t numImages = 0;
+    uint32_t* pageNums = malloc(capacity * sizeof(uint32_t));
+    void* images = malloc((size_t)capacity * PAGE_SIZE);
+    uint64_t expectedSequence = 1;
+
+    while (true) {
+        WalRecordHeader header;
+        if (ReadFully(wal->FileDescriptor, &header, sizeof(header)) != sizeof(header) || header.Sequence != expectedSequence) {
+            break;
+        }
+        expectedSequence += 1;
+
+        if (header.Type == WAL_RECORD_PAGE) {
+            if (numImages == capacity) {
+                capacity *= 2;
+                pageNums = realloc(pageNums, capacity * sizeof(uint32_t));
+                images = realloc(images, (size_t)capacity * PAGE_SIZE);
+            }
+            void* image = images + (size_t)numImages * PAGE_SIZE;
+            if (ReadFully(wal->FileDescriptor, image, PAGE_SIZE) != PAGE_SIZE || WalRecordChecksum(&header, image, PAGE_SIZE) != header.Checksum) {
+                break;
+            }
+            pageNums[numImages] = header.PageNum;
+            numImages += 1;
+        } else if (header.Type == WAL_RECORD_COMMIT) {
+            if (WalRecordChecksum(&header, NULL, 0) != header.Checksum || header.PageNum != numImages) {
+                break;
+            }
+            for (uint32_t i = 0; i < numImages; i++) {
+                off_t offset = (off_t)pageNums[i] * PAGE_SIZE;
+                StampPageChecksum(images + (size_t)i * PAGE_SIZE);
+                if (pwrite(dbFileDescriptor, images + (size_t)i * PAGE_SIZE, PAGE_SIZE, offset) != PAGE_SIZE) {
+                    printf("Error replaying write-ahead log: %d\n", errno);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            numImages = 0;
+        } else {
+            break;
+        }
+    }
+
+    free(pageNums);
+    free(images);
+
+    if (fsync(dbFileDescriptor) == -1) {
+        printf("Error syncing db file: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    WalTruncate(wal);
+}
+
+// * Sleeps until there is an unsynced commit, then until it is
+// * CommitIntervalMs old, unless a statement syncs the log first
+void* WalSyncWorker(void* argument) {
+    Wal* wal = argument;
+    pthread_mutex_lock(&wal->Lock);
+    while (!wal->Stopping) {
+        if (wal->UnsyncedCommits == 0) {
+            pthread_cond_wait(&wal->SyncerWake, &wal->Lock);
+            continue;
+        }
+        struct timespec deadline = wal->FirstUnsyncedAt;
+        uint64_t deadlineNs = deadline.tv_nsec + (uint64_t)wal->CommitIntervalMs * 1000000;
+        deadline.tv_sec += deadlineNs / 1000000000;
+        deadline.tv_nsec = deadlineNs % 1000000000;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+            WalSync(wal);
+            continue;
+        }
+        pthread_cond_timedwait(&wal->SyncerWake, &wal->Lock, &deadline);
+    }
+    pthread_mutex_unlock(&wal->Lock);
+    return NULL;
+}
+
+// * Started once recovery is done with the log
+void StartWalSyncer(Wal* wal) {
+    if (pthread_create(&wal->Syncer, NULL, WalSyncWorker, wal) != 0) {
+        printf("Unable to start write-ahead log sync thread.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void CloseWal(Wal* wal) {
+    pthread_mutex_lock(&wal->Lock);
+    wal->Stopping = true;
+    pthread_cond_signal(&wal->SyncerWake);
+    pthread_mutex_unlock(&wal->Lock);
+    pthread_join(wal->Syncer, NULL);
+
+    pthread_mutex_lock(&wal->Lock);
+    WalSync(wal);
+    pthread_mutex_unlock(&wal->Lock);
+    close(wal->FileDescriptor);
+    // * A clean shutdown leaves everything in the database file
+    unlink(wal->Filename);
+    pthread_cond_destroy(&wal->SyncerWake);
+    pthread_mutex_destroy(&wal->Lock);
+    free(wal->Filename);
+    free(wal);
+}
+
+size_t MappingReservation(off_t fileLength) {
+    size_t reservation = MMAP_MIN_RESERVATION;
+    while (reservation < 2 * (size_t)fileLength) {
+        reservation *= 2;
+    }
+    return reservation;
+}
+
+// * Reserves address space well past the end of the file, so the file can grow
+// * under the mapping with ftruncate alone and page pointers never move.
+void MapPager(Pager* pager) {
+    pager->MappingLength = MappingReservation(pager->FileLength);
+    pager->Mapping = mmap(NULL, pager->MappingLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, pager->FileDescriptor, 0);
+    if (pager->Mapping == MAP_FAILED) {
+        printf("Unable to map db file: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    pager->PageFlags = calloc(pager->FileLength / PAGE_SIZE + 1, sizeof(uint8_t));
+    pager->MappedPins = 0;
+}
+
+// * Extends the file so pageNum is backed, growing by at least a megabyte or
+// * half the file at a time so ftruncate stays rare during inserts.
+void GrowMappedFile(Pager* pager, uint32_t pageNum) {
+    off_t needed = ((off_t)pageNum + 1) * PAGE_SIZE;
+    off_t growth = pager->FileLength / 2 > MMAP_MIN_GROWTH ? pager->FileLength / 2 : MMAP_MIN_GROWTH;
+    off_t newLength = pager->FileLength + growth;
+    if (newLength < needed) {
+        newLength = needed;
+    }
+    if ((size_t)newLength > pager->MappingLength) {
+        newLength = needed;
+    }
+    if ((size_t)newLength > pager->MappingLength) {
+        printf("Tried to fetch page %d beyond the %zu-byte memory map\n", pageNum, pager->MappingLength);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ftruncate(pager->FileDescriptor, newLength) == -1) {
+        printf("Error extending db file: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    pager->PageFlags = realloc(pager->PageFlags, newLength / PAGE_SIZE + 1);
+    memset(pager->PageFlags + pager->FileLength / PAGE_SIZE, 0, (newLength - pager->FileLength) / PAGE_SIZE + 1);
+    pager->FileLength = newLength;
+}
+
+// * Moves the mapping to a larger reservation with mremap once the file has
+// * used half of it. Only called between statements, when nothing is pinned,
+// * because the mapping may move.
+void ReserveMappedPages(Pager* pager) {
+    if (pager->Mapping == NULL || pager->MappedPins > 0 || (size_t)pager->FileLength <= pager->MappingLength / 2) {
+        return;
+    }
+    size_t newLength = MappingReservation(pager->FileLength);
+    void* mapping = mremap(pager->Mapping, pager->MappingLength, newLength, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED) {
+        printf("Unable to grow memory map: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    pager->Mapping = mapping;
+    pager->MappingLength = newLength;
+}
+
+void* GetMappedPage(Pager* pager, uint32_t pageNum) {
+    if ((off_t)pageNum * PAGE_SIZE >= pager->FileLength) {
+        GrowMappedFile(pager, pageNum);
+    }
+    void* page = pager->Mapping + (size_t)pageNum * PAGE_SIZE;
+    if (pageNum >= pager->NumPages) {
+        pager->NumPages = pageNum + 1;
+        pager->PageFlags[pageNum] |= PAGE_VERIFIED;
+    } else if (!(pager->PageFlags[pageNum] & PAGE_VERIFIED)) {
+        CheckRequestedPage(page, pageNum);
+        pager->PageFlags[pageNum] |= PAGE_VERIFIED;
+    }
+    pager->MappedPins += 1;
+    return page;
+}
+
+// * Hints the kernel about the access pattern of the statement about to run.
+// * Only the memory map takes it; the buffer pool finds sequential runs itself.
+void PagerAdvise(Pager* pager, EPagerAccess access) {
+    if (pager->Mapping == NULL) {
+        return;
+    }
+    int advice = access == PAGER_ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM;
+    madvise(pager->Mapping, pager->FileLength, advice);
+}
+
+void UnmapPager(Pager* pager) {
+    munmap(pager->Mapping, pager->MappingLength);
+    // * Drop the unused tail GrowMappedFile allocated ahead of time
+    if (ftruncate(pager->FileDescriptor, (off_t)pager->NumPages * PAGE_SIZE) == -1) {
+        printf("Error truncating db file: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    free(pager->PageFlags);
+    pager->Mapping = NULL;
+}
+
+void* ReadAheadWorker(void* argument);
+void* FlusherWorker(void* argument);
+
+void InitializePool(Pager* pager, const DBOptions* options) {
+    pager->NumFrames = options->PoolFrames;
+    pager->Arena = aligned_alloc(PAGE_SIZE, (size_t)pager->NumFrames * PAGE_SIZE);
+    pager->Frames = calloc(pager->NumFrames, sizeof(Frame));
+
+    // * Keep the page table at most half full so probe chains stay short
+    uint32_t pageTableSize = 1;
+    while (pageTableSize < 2 * pager->NumFrames) {
+        pageTableSize <<= 1;
+    }
+    pager->PageTable = calloc(pageTableSize, sizeof(uint32_t));
+    pager->PageTableMask = pageTableSize - 1;
+    pager->ClockHand = 0;
+
+    if (pager->Arena == NULL || pager->Frames == NULL || pager->PageTable == NULL) {
+        printf("Unable to allocate buffer pool of %d frames\n", pager->NumFrames);
+        exit(EXIT_FAILURE);
+    }
+    pager->FlushCandidates = malloc(pager->NumFrames * sizeof(uint32_t));
+
+    // * Frames being read ahead cannot be evicted, so they are capped at a
+    // * quarter of the pool
+    pager->ReadAheadPages = options->ReadAheadPages;
+    if (pager->ReadAheadPages > READAHEAD_MAX_PAGES) {
+        pager->ReadAheadPages = READAHEAD_MAX_PAGES;
+    }
+    if (pager->ReadAheadPages > pager->NumFrames / 4) {
+        pager->ReadAheadPages = pager->NumFrames / 4;
+    }
+    for (uint32_t i = 0; i < READAHEAD_STREAMS; i++) {
+        pager->Streams[i].NextPage = UINT32_MAX;
+        pager->Streams[i].ReadAheadEnd = 0;
+    }
+    pager->NextStream = 0;
+    pager->NumLoadingFrames = 0;
+    pager->ReadQueue = malloc(READAHEAD_QUEUE_SIZE * sizeof(ReadRequest));
+    pager->ReadQueueHead = 0;
+    pager->ReadQueueLength = 0;
+    for (uint32_t i = 0; i < READAHEAD_THREADS && pager->ReadAheadPages > 0; i++) {
+        if (pthread_create(&pager->ReadThreads[i], NULL, ReadAheadWorker, pager) != 0) {
+            printf("Unable to start read-ahead thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// * Drops the run of never-written pages at the end of the file, such as the
+// * room GrowMappedFile extends the file by ahead of time when the process
+// * dies before closing. No page past the last written one can be in use.
+// * Returns the new length.
+off_t TrimUnusedPages(int fileDescriptor, off_t fileLength) {
+    void* buffer = aligned_alloc(PAGE_SIZE, (size_t)VERIFY_CHUNK_PAGES * PAGE_SIZE);
+    off_t newLength = fileLength;
+    bool trimming = true;
+    while (trimming && newLength > 0) {
+        uint32_t numPages = newLength / PAGE_SIZE < VERIFY_CHUNK_PAGES ? newLength / PAGE_SIZE : VERIFY_CHUNK_PAGES;
+        off_t first = newLength - (off_t)numPages * PAGE_SIZE;
+        struct iovec vector = {buffer, (size_t)numPages * PAGE_SIZE};
+        if (ReadPagesAt(fileDescriptor, &vector, 1, first) != (size_t)numPages * PAGE_SIZE) {
+            break;
+        }
+        for (uint32_t i = numPages; i > 0 && trimming; i--) {
+            if (CheckPage(buffer + (size_t)(i - 1) * PAGE_SIZE) == PAGE_CHECK_UNUSED) {
+                newLength -= PAGE_SIZE;
+            } else {
+                trimming = false;
+            }
+        }
+    }
+    free(buffer);
+
+    if (newLength != fileLength && ftruncate(fileDescriptor, newLength) == -1) {
+        printf("Error truncating db file: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    return newLength;
+}
+
+Pager* OpenPager(const char* filename, const DBOptions* options) {
+    int fileDescriptor = open(filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+
+    if (fileDescriptor == -1) {
+        printf("Unable to open file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Wal* wal = OpenWal(filename, options);
+    RecoverWal(wal, fileDescriptor);
+    StartWalSyncer(wal);
+
+    off_t fileLength = lseek(fileDescriptor, 0, SEEK_END);
+    if (fileLength % PAGE_SIZE == 0) {
+        fileLength = TrimUnusedPages(fileDescriptor, fileLength);
+    }
+
+    Pager* pager = malloc(sizeof(Pager));
+    pthread_mutex_init(&pager->Lock, NULL);
+    pager->Latches = calloc(UINT32_MAX / PAGE_LATCH_CHUNK + 1, sizeof(pthread_rwlock_t*));
+    pager->Wal = wal;
+    pager->FileDescriptor = fileDescriptor;
+    pager->FileLength = fileLength;
+    pager->NumPages = fileLength / PAGE_SIZE;
+
+    if (fileLength % PAGE_SIZE != 0) {
+        printf("Db file is not a whole number of pages. Corrupt file.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pager->PendingPagesCapacity = 16;
+    pager->PendingPages = malloc(pager->PendingPagesCapacity * sizeof(uint32_t));
+    pager->NumPendingPages = 0;
+    pager->SpilledPagesCapacity = 16;
+    pager->SpilledPages = malloc(pager->SpilledPagesCapacity * sizeof(SpilledPage));
+    pager->NumSpilledPages = 0;
+    pager->NumSpilledRecords = 0;
+    pager->Committing = false;
+
+    pager->Mapping = NULL;
+    pager->NumFrames = 0;
+    pager->Arena = NULL;
+    pager->Frames = NULL;
+    pager->PageTable = NULL;
+    pager->ReadAheadPages = 0;
+    pager->ReadQueue = NULL;
+    pager->Stopping = false;
+    pthread_cond_init(&pager->ReadQueued, NULL);
+    pthread_cond_init(&pager->PageLoaded, NULL);
+    pager->FlushCandidates = NULL;
+
+    if (options->UseMmap) {
+        MapPager(pager);
+    } else {
+        InitializePool(pager, options);
+    }
+
+    uint64_t flushRatePages = (uint64_t)options->FlushRateMB * (1024 * 1024 / PAGE_SIZE);
+    pager->FlushRatePages = flushRatePages < UINT32_MAX ? flushRatePages : UINT32_MAX;
+    pager->FlushCursor = 0;
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&pager->FlusherWake, &attributes);
+    pthread_condattr_destroy(&attributes);
+    if (pager->FlushRatePages > 0 && pthread_create(&pager->Flusher, NULL, FlusherWorker, pager) != 0) {
+        printf("Unable to start background flusher.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return pager;
+}
+
+void* FrameData(Pager* pager, uint32_t frameIndex) {
+    return pager->Arena + (size_t)frameIndex * PAGE_SIZE;
+}
+
+void* ResidentPageData(Pager* pager, uint32_t pageNum);
+
+uint32_t PageTableHash(Pager* pager, uint32_t pageNum) {
+    return (pageNum * 2654435761u) & pager->PageTableMask;
+}
+
+// * Returns the frame holding the page, or -1 if it is not resident
+int64_t PageTableFind(Pager* pager, uint32_t pageNum) {
+    uint32_t slot = PageTableHash(pager, pageNum);
+    while (pager->PageTable[slot] != 0) {
+        uint32_t frameIndex = pager->PageTable[slot] - 1;
+        if (pager->Frames[frameIndex].PageNum == pageNum) {
+            return frameIndex;
+        }
+        slot = (slot + 1) & pager->PageTableMask;
+    }
+    return -1;
+}
+
+void PageTableInsert(Pager* pager, uint32_t pageNum, uint32_t frameIndex) {
+    uint32_t slot = PageTableHash(pager, pageNum);
+    while (pager->PageTable[slot] != 0) {
+        slot = (slot + 1) & pager->PageTableMask;
+    }
+    pager->PageTable[slot] = frameIndex + 1;
+}
+
+void PageTableRemove(Pager* pager, uint32_t pageNum) {
+    uint32_t mask = pager->PageTableMask;
+    uint32_t hole = PageTableHash(pager, pageNum);
+    while (pager->Frames[pager->PageTable[hole] - 1].PageNum != pageNum) {
+        hole = (hole + 1) & mask;
+    }
+
+    // * Backward-shift deletion: pull later entries of the probe chain into the
+    // * hole unless that would move them in front of their home bucket.
+    uint32_t next = (hole + 1) & mask;
+    while (pager->PageTable[next] != 0) {
+        uint32_t home = PageTableHash(pager, pager->Frames[pager->PageTable[next] - 1].PageNum);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            pager->PageTable[hole] = pager->PageTable[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    pager->PageTable[hole] = 0;
+}
+
+Frame* GetFrame(Pager* pager, uint32_t pageNum) {
+    int64_t frameIndex = PageTableFind(pager, pageNum);
+    if (frameIndex < 0) {
+        printf("Tried to access page %d which is not in the buffer pool\n", pageNum);
+        exit(EXIT_FAILURE);
+    }
+    return &pager->Frames[frameIndex];
+}
+
+void FlushPager(Pager* pager, uint32_t pageNum) {
+    void* page = ResidentPageData(pager, pageNum);
+    if (page == NULL) {
+        printf("Tried to flush null page\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t startedAt = StatsNow();
+    StampPageChecksum(page);
+    off_t offset = (off_t)pageNum * PAGE_SIZE;
+    ssize_t bytesWritten = pwrite(pager->FileDescriptor, page, PAGE_SIZE, offset);
+
+    if (bytesWritten != PAGE_SIZE) {
+        printf("Error writing: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    StatsRecord(STATS_FLUSH_PAGE, startedAt);
+    Stats.PagesFlushed += 1;
+    Stats.BytesFlushed += bytesWritten;
+
+    if (pager->Mapping != NULL) {
+        pager->PageFlags[pageNum] &= ~PAGE_DIRTY;
+        return;
+    }
+    GetFrame(pager, pageNum)->Dirty = false;
+    if (offset + PAGE_SIZE > pager->FileLength) {
+        pager->FileLength = offset + PAGE_SIZE;
+    }
+}
+
+// * CLOCK replacement. Unpinned frames get a second chance if they were
+// * referenced since the hand last passed; dirty victims are written back once
+// * the log covering them is on disk. Frames the running statement modified
+// * are never victims, since their new contents are not logged yet, and
+// * neither are frames still loading. Returns -1 if every frame is taken.
+int64_t FindVictimFrame(Pager* pager) {
+    for (uint32_t i = 0; i < 2 * pager->NumFrames; i++) {
+        uint32_t frameIndex = pager->ClockHand;
+        Frame* frame = &pager->Frames[frameIndex];
+        pager->ClockHand = (pager->ClockHand + 1) % pager->NumFrames;
+
+        if (!frame->InUse) {
+            return frameIndex;
+        }
+        if (frame->PinCount > 0 || frame->LogPending || frame->Loading) {
+            continue;
+        }
+        if (frame->Referenced) {
+            frame->Referenced = false;
+            continue;
+        }
+        if (frame->Dirty) {
+            pthread_mutex_lock(&pager->Wal->Lock);
+            WalSync(pager->Wal);
+            pthread_mutex_unlock(&pager->Wal->Lock);
+            FlushPager(pager, frame->PageNum);
+        }
+        PageTableRemove(pager, frame->PageNum);
+        frame->InUse = false;
+        return frameIndex;
+    }
+    return -1;
+}
+
+// * Returns the index of the page in SpilledPages, or -1 if it is not spilled
+int64_t FindSpilledPage(Pager* pager, uint32_t pageNum) {
+    for (uint32_t i = 0; i < pager->NumSpilledPages; i++) {
+        if (pager->SpilledPages[i].PageNum == pageNum) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AddPendingPage(Pager* pager, uint32_t pageNum) {
+    if (pager->NumPendingPages == pager->PendingPagesCapacity) {
+        pager->PendingPagesCapacity *= 2;
+        pager->PendingPages = realloc(pager->PendingPages, pager->PendingPagesCapacity * sizeof(uint32_t));
+    }
+    pager->PendingPages[pager->NumPendingPages++] = pageNum;
+}
+
+void RemovePendingPage(Pager* pager, uint32_t pageNum) {
+    for (uint32_t i = 0; i < pager->NumPendingPages; i++) {
+        if (pager->PendingPages[i] == pageNum) {
+            pager->NumPendingPages -= 1;
+            memmove(&pager->PendingPages[i], &pager->PendingPages[i + 1], (pager->NumPendingPages - i) * sizeof(uint32_t));
+            return;
+        }
+    }
+}
+
+// * Appends the image of an unpinned page of the running statement to the log
+// * and frees its frame. Returns -1 if every such page is pinned or loading.
+int64_t SpillFrame(Pager* pager) {
+    for (uint32_t i = 0; i < pager->NumFrames; i++) {
+        uint32_t frameIndex = pager->ClockHand;
+        Frame* frame = &pager->Frames[frameIndex];
+        pager->ClockHand = (pager->ClockHand + 1) % pager->NumFrames;
+        if (!frame->InUse || !frame->LogPending || frame->PinCount > 0 || frame->Loading) {
+            continue;
+        }
+
+        Wal* wal = pager->Wal;
+        void* page = FrameData(pager, frameIndex);
+        WalRecordHeader header;
+        pthread_mutex_lock(&wal->Lock);
+        header.Type = WAL_RECORD_PAGE;
+        header.PageNum = frame->PageNum;
+        header.Sequence = wal->NextSequence++;
+        header.Reserved = 0;
+        header.Checksum = WalRecordChecksum(&header, page, PAGE_SIZE);
+        struct iovec vectors[2] = {{&header, sizeof(header)}, {page, PAGE_SIZE}};
+        off_t offset = wal->FileLength + sizeof(header);
+        WalWrite(wal, vectors, 2);
+        pthread_mutex_unlock(&wal->Lock);
+
+        if (pager->NumSpilledPages == pager->SpilledPagesCapacity) {
+            pager->SpilledPagesCapacity *= 2;
+            pager->SpilledPages = realloc(pager->SpilledPages, pager->SpilledPagesCapacity * sizeof(SpilledPage));
+        }
+        pager->SpilledPages[pager->NumSpilledPages].PageNum = frame->PageNum;
+        pager->SpilledPages[pager->NumSpilledPages].Offset = offset;
+        pager->NumSpilledPages += 1;
+        pager->NumSpilledRecords += 1;
+        Stats.PagesSpilled += 1;
+
+        RemovePendingPage(pager, frame->PageNum);
+        PageTableRemove(pager, frame->PageNum);
+        frame->InUse = false;
+        return frameIndex;
+    }
+    return -1;
+}
+
+// * Spills a page of the running statement when the clock finds no victim. A
+// * commit in progress is logging the pending pages, so a request then waits
+// * for it to finish and free them instead.
+uint32_t ClaimFrame(Pager* pager) {
+    while (true) {
+        int64_t frameIndex = FindVictimFrame(pager);
+        if (frameIndex >= 0) {
+            return frameIndex;
+        }
+        if (pager->Committing) {
+            pthread_cond_wait(&pager->PageLoaded, &pager->Lock);
+            continue;
+        }
+        frameIndex = SpillFrame(pager);
+        if (frameIndex < 0) {
+            printf("Buffer pool exhausted: all %d frames are pinned.\n", pager->NumFrames);
+            exit(EXIT_FAILURE);
+        }
+        return frameIndex;
+    }
+}
+
+// * Puts the page in the frame, unpinned and marked Loading
+void InstallFrame(Pager* pager, uint32_t frameIndex, uint32_t pageNum) {
+    Frame* frame = &pager->Frames[frameIndex];
+    frame->PageNum = pageNum;
+    frame->PinCount = 0;
+    frame->InUse = true;
+    frame->Dirty = false;
+    frame->LogPending = false;
+    frame->Referenced = false;
+    frame->Loading = true;
+    frame->Prefetched = false;
+    frame->Verified = false;
+    PageTableInsert(pager, pageNum, frameIndex);
+}
+
+// * Queues reads of the pages in [from, to) that are on disk and not resident,
+// * one request per run of consecutive ones. Read-ahead is only a hint, so it
+// * stops early rather than wait for frames or room in the queue.
+void QueueReadAhead(Pager* pager, uint32_t from, uint32_t to) {
+    uint32_t pagesOnDisk = pager->FileLength / PAGE_SIZE;
+    uint32_t pageNum = from;
+    while (pageNum < to && pageNum < pagesOnDisk && pager->ReadQueueLength < READAHEAD_QUEUE_SIZE) {
+        if (PageTableFind(pager, pageNum) >= 0 || FindSpilledPage(pager, pageNum) >= 0) {
+            pageNum++;
+            continue;
+        }
+
+        ReadRequest* request = &pager->ReadQueue[(pager->ReadQueueHead + pager->ReadQueueLength) % READAHEAD_QUEUE_SIZE];
+        request->PageNum = pageNum;
+        request->NumPages = 0;
+        while (pageNum < to && pageNum < pagesOnDisk && PageTableFind(pager, pageNum) < 0 && FindSpilledPage(pager, pageNum) < 0 && pager->NumLoadingFrames < pager->ReadAheadPages) {
+            int64_t frameIndex = FindVictimFrame(pager);
+            if (frameIndex < 0) {
+                break;
+            }
+            InstallFrame(pager, frameIndex, pageNum);
+            pager->Frames[frameIndex].Prefetched = true;
+            pager->Frames[frameIndex].Referenced = true; // * Survives one pass of the clock before it is read
+            pager->NumLoadingFrames += 1;
+            request->FrameIndices[request->NumPages++] = frameIndex;
+            pageNum++;
+        }
+        if (request->NumPages == 0) {
+            return;
+        }
+        pager->ReadQueueLength += 1;
+        pthread_cond_signal(&pager->ReadQueued);
+    }
+}
+
+// * Advances the stream the requested page continues, reading ahead of it,
+// * or starts a new stream at the page
+void ReadAheadNotify(Pager* pager, uint32_t pageNum) {
+    ReadStream* stream = NULL;
+    for (uint32_t i = 0; i < READAHEAD_STREAMS && stream == NULL; i++) {
+        if (pager->Streams[i].NextPage == pageNum) {
+            stream = &pager->Streams[i];
+        }
+    }
+    if (stream == NULL) {
+        stream = &pager->Streams[pager->NextStream];
+        pager->NextStream = (pager->NextStream + 1) % READAHEAD_STREAMS;
+        stream->NextPage = pageNum + 1;
+        stream->ReadAheadEnd = pageNum + 1;
+        return;
+    }
+
+    stream->NextPage = pageNum + 1;
+    if (stream->ReadAheadEnd < pageNum + 1) {
+        stream->ReadAheadEnd = pageNum + 1;
+    }
+    if (stream->ReadAheadEnd - (pageNum + 1) <= pager->ReadAheadPages / 2) {
+        QueueReadAhead(pager, stream->ReadAheadEnd, pageNum + 1 + pager->ReadAheadPages);
+        stream->ReadAheadEnd = pageNum + 1 + pager->ReadAheadPages;
+    }
+}
+
+void* ReadAheadWorker(void* argument) {
+    Pager* pager = argument;
+    struct iovec vectors[READAHEAD_MAX_PAGES];
+    bool verified[READAHEAD_MAX_PAGES];
+
+    pthread_mutex_lock(&pager->Lock);
+    while (true) {
+        while (pager->ReadQueueLength == 0 && !pager->Stopping) {
+            pthread_cond_wait(&pager->ReadQueued, &pager->Lock);
+        }
+        if (pager->ReadQueueLength == 0) {
+            break; // * Stopping, with every queued read done
+        }
+        ReadRequest request = pager->ReadQueue[pager->ReadQueueHead];
+        pager->ReadQueueHead = (pager->ReadQueueHead + 1) % READAHEAD_QUEUE_SIZE;
+        pager->ReadQueueLength -= 1;
+        pthread_mutex_unlock(&pager->Lock);
+
+        uint64_t startedAt = StatsNow();
+        for (uint32_t i = 0; i < request.NumPages; i++) {
+            vectors[i].iov_base = FrameData(pager, request.FrameIndices[i]);
+            vectors[i].iov_len = PAGE_SIZE;
+        }
+        size_t bytesRead = ReadPagesAt(pager->FileDescriptor, vectors, request.NumPages, (off_t)request.PageNum * PAGE_SIZE);
+        for (uint32_t i = 0; i < request.NumPages; i++) {
+            size_t pageRead = bytesRead > (size_t)i * PAGE_SIZE ? bytesRead - (size_t)i * PAGE_SIZE : 0;
+            if (pageRead < PAGE_SIZE) {
+                memset(FrameData(pager, request.FrameIndices[i]) + pageRead, 0, PAGE_SIZE - pageRead);
+            }
+            // * Checked here, off Lock; a page that fails is checked again,
+            // * and reported, only if it is requested
+            verified[i] = CheckPage(FrameData(pager, request.FrameIndices[i])) == PAGE_CHECK_VALID;
+        }
+        StatsRecord(STATS_READ_AHEAD, startedAt);
+
+        pthread_mutex_lock(&pager->Lock);
+        for (uint32_t i = 0; i < request.NumPages; i++) {
+            pager->Frames[request.FrameIndices[i]].Loading = false;
+            pager->Frames[request.FrameIndices[i]].Verified = verified[i];
+        }
+        pager->NumLoadingFrames -= request.NumPages;
+        Stats.PagesPrefetched += request.NumPages;
+        Stats.BytesRead += bytesRead;
+        pthread_cond_broadcast(&pager->PageLoaded);
+    }
+    pthread_mutex_unlock(&pager->Lock);
+    return NULL;
+}
+
+// * Misses read the page without Lock held. The frame is in the page table
+// * and marked Loading meanwhile, so requests for the same page wait on it
+// * instead of reading it again.
+void* GetPoolPage(Pager* pager, uint32_t pageNum) {
+    int64_t frameIndex = PageTableFind(pager, pageNum);
+    uint64_t startedAt = 0;
+    if (frameIndex < 0) {
+        // * Claiming may wait out a commit, during which another request can
+        // * load the page; the claimed frame then stays free
+        startedAt = StatsNow();
+        uint32_t claimed = ClaimFrame(pager);
+        frameIndex = PageTableFind(pager, pageNum);
+        if (frameIndex < 0) {
+            frameIndex = claimed;
+        }
+    }
+
+    if (!pager->Frames[frameIndex].InUse) {
+        // Cache miss. Load the page into the claimed frame from file.
+        InstallFrame(pager, frameIndex, pageNum);
+        Frame* frame = &pager->Frames[frameIndex];
+        frame->PinCount = 1;
+        frame->Referenced = true;
+        if (pageNum >= pager->NumPages) {
+            pager->NumPages = pageNum + 1;
+        }
+        if (pager->ReadAheadPages > 0) {
+            ReadAheadNotify(pager, pageNum);
+        }
+
+        void* page = FrameData(pager, frameIndex);
+        off_t offset = (off_t)pageNum * PAGE_SIZE;
+        size_t bytesRead = 0;
+        int64_t spillIndex = pager->NumSpilledPages > 0 ? FindSpilledPage(pager, pageNum) : -1;
+        if (spillIndex >= 0) {
+            // * Back from the log, pending again so the commit logs it anew
+            pthread_mutex_lock(&pager->Wal->Lock);
+            struct iovec vector = {page, PAGE_SIZE};
+            bytesRead = ReadPagesAt(pager->Wal->FileDescriptor, &vector, 1, pager->SpilledPages[spillIndex].Offset);
+            pthread_mutex_unlock(&pager->Wal->Lock);
+            if (bytesRead != PAGE_SIZE) {
+                printf("Error reading spilled page %d from write-ahead log: %d\n", pageNum, errno);
+                exit(EXIT_FAILURE);
+            }
+            pager->SpilledPages[spillIndex] = pager->SpilledPages[--pager->NumSpilledPages];
+            frame->Dirty = true;
+            frame->LogPending = true;
+            AddPendingPage(pager, pageNum);
+        } else if (offset < pager->FileLength) {
+            pthread_mutex_unlock(&pager->Lock);
+            struct iovec vector = {page, PAGE_SIZE};
+            bytesRead = ReadPagesAt(pager->FileDescriptor, &vector, 1, offset);
+            memset(page + bytesRead, 0, PAGE_SIZE - bytesRead);
+            CheckRequestedPage(page, pageNum);
+            pthread_mutex_lock(&pager->Lock);
+        } else {
+            memset(page, 0, PAGE_SIZE);
+        }
+        frame->Loading = false;
+        frame->Verified = true;
+        pthread_cond_broadcast(&pager->PageLoaded);
+        StatsRecord(STATS_GET_PAGE_MISS, startedAt);
+        Stats.PageMisses += 1;
+        Stats.BytesRead += bytesRead;
+        return page;
+    }
+
+    Frame* frame = &pager->Frames[frameIndex];
+    frame->PinCount += 1;
+    frame->Referenced = true;
+    if (frame->Loading) {
+        uint64_t startedAt = StatsNow();
+        while (frame->Loading) {
+            pthread_cond_wait(&pager->PageLoaded, &pager->Lock);
+        }
+        StatsRecord(STATS_READ_AHEAD_WAIT, startedAt);
+    }
+    if (!frame->Verified) {
+        CheckRequestedPage(FrameData(pager, frameIndex), pageNum);
+        frame->Verified = true;
+    }
+    if (frame->Prefetched) {
+        frame->Prefetched = false;
+        ReadAheadNotify(pager, pageNum);
+    }
+    return FrameData(pager, frameIndex);
+}
+
+// * Returns the page pinned in the buffer pool. Every GetPage must be paired
+// * with an UnpinPage once the caller no longer holds the pointer. Pinning
+// * only keeps the page in memory; LatchPage guards its contents.
+void* GetPage(Pager* pager, uint32_t pageNum) {
+    pthread_mutex_lock(&pager->Lock);
+    Stats.PageRequests += 1;
+    void* page = pager->Mapping != NULL ? GetMappedPage(pager, pageNum) : GetPoolPage(pager, pageNum);
+    pthread_mutex_unlock(&pager->Lock);
+    return page;
+}
+
+// * Pointer to a page that is already resident, or NULL, without pinning it
+void* ResidentPageData(Pager* pager, uint32_t pageNum) {
+    if (pager->Mapping != NULL) {
+        return (off_t)pageNum * PAGE_SIZE < pager->FileLength ? pager->Mapping + (size_t)pageNum * PAGE_SIZE : NULL;
+    }
+    int64_t frameIndex = PageTableFind(pager, pageNum);
+    return frameIndex < 0 ? NULL : FrameData(pager, frameIndex);
+}
+
+void UnpinPage(Pager* pager, uint32_t pageNum) {
+    pthread_mutex_lock(&pager->Lock);
+    if (pager->Mapping != NULL) {
+        ASSERT(pager->MappedPins > 0, "Unpinned a page that was not pinned");
+        pager->MappedPins -= 1;
+    } else {
+        Frame* frame = GetFrame(pager, pageNum);
+        ASSERT(frame->PinCount > 0, "Unpinned a page that was not pinned");
+        frame->PinCount -= 1;
+    }
+    pthread_mutex_unlock(&pager->Lock);
+}
+
+// * Returns the latch of a page, allocating its chunk the first time a page in
+// * it is latched. Chunks are published with a release store, so lookups of
+// * existing latches do not need Lock.
+pthread_rwlock_t* PageLatch(Pager* pager, uint32_t pageNum) {
+    pthread_rwlock_t** slot = &pager->Latches[pageNum / PAGE_LATCH_CHUNK];
+    pthread_rwlock_t* chunk = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (chunk == NULL) {
+        pthread_mutex_lock(&pager->Lock);
+        chunk = *slot;
+        if (chunk == NULL) {
+            // * Prefer writers so a stream of scans cannot starve an insert
+            pthread_rwlockattr_t attributes;
+            pthread_rwlockattr_init(&attributes);
+            pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+            chunk = malloc(PAGE_LATCH_CHUNK * sizeof(pthread_rwlock_t));
+            for (uint32_t i = 0; i < PAGE_LATCH_CHUNK; i++) {
+                pthread_rwlock_init(&chunk[i], &attributes);
+            }
+            pthread_rwlockattr_destroy(&attributes);
+            __atomic_store_n(slot, chunk, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&pager->Lock);
+    }
+    return &chunk[pageNum % PAGE_LATCH_CHUNK];
+}
+
+// * Latches are independent of pins: a page may be latched before it is
+// * fetched and stay latched after it is unpinned.
+void LatchPage(Pager* pager, uint32_t pageNum, ELatchMode mode) {
+    switch (mode) {
+    case (LATCH_NONE):
+        break;
+    case (LATCH_SHARED):
+        pthread_rwlock_rdlock(PageLatch(pager, pageNum));
+        break;
+    case (LATCH_EXCLUSIVE):
+        pthread_rwlock_wrlock(PageLatch(pager, pageNum));
+        break;
+    }
+}
+
+void UnlatchPage(Pager* pager, uint32_t pageNum) {
+    pthread_rwlock_unlock(PageLatch(pager, pageNum));
+}
+
+void MarkPageDirty(Pager* pager, uint32_t pageNum) {
+    pthread_mutex_lock(&pager->Lock);
+    if (pager->Mapping != NULL) {
+        uint8_t* flags = &pager->PageFlags[pageNum];
+        if (!(*flags & PAGE_LOG_PENDING)) {
+            AddPendingPage(pager, pageNum);
+        }
+        *flags |= PAGE_DIRTY | PAGE_LOG_PENDING;
+    } else {
+        int64_t frameIndex = PageTableFind(pager, pageNum);
+        ASSERT(frameIndex >= 0, "Dirtied a page that is not in the buffer pool");
+
+        Frame* frame = &pager->Frames[frameIndex];
+        frame->Dirty = true;
+        if (!frame->LogPending) {
+            frame->LogPending = true;
+            AddPendingPage(pager, pageNum);
+        }
+    }
+    pthread_mutex_unlock(&pager->Lock);
+}
+
+int ComparePageNums(const void* left, const void* right) {
+    uint32_t leftPageNum = *(const uint32_t*)left;
+    uint32_t rightPageNum = *(const uint32_t*)right;
+    return leftPageNum < rightPageNum ? -1 : leftPageNum > rightPageNum;
+}
+
+// * Gathers the dirty pages in the pool from page `from` on into
+// * FlushCandidates, in page order, and returns how many there are. With
+// * committedOnly it leaves out pages the flusher may not write yet: ones the
+// * running statement modified, and pinned or loading ones.
+uint32_t CollectDirtyFrames(Pager* pager, uint32_t from, bool committedOnly) {
+    uint32_t numDirty = 0;
+    for (uint32_t i = 0; i < pager->NumFrames; i++) {
+        Frame* frame = &pager->Frames[i];
+        if (!frame->InUse || !frame->Dirty || frame->PageNum < from) {
+            continue;
+        }
+        if (committedOnly && (frame->LogPending || frame->PinCount > 0 || frame->Loading)) {
+            continue;
+        }
+        pager->FlushCandidates[numDirty++] = frame->PageNum;
+    }
+    qsort(pager->FlushCandidates, numDirty, sizeof(uint32_t), ComparePageNums);
+    return numDirty;
+}
+
+// * Writes up to FLUSHER_BATCH_PAGES committed dirty pages from the flusher's
+// * cursor on, starting the sweep over from page 0 once it finds none. A
+// * memory map is only flushed while nothing is pinned, since pins are not
+// * counted per page there. Returns how many pages it wrote. Callers hold Lock.
+uint32_t FlushDirtyBatch(Pager* pager) {
+    uint32_t pages[FLUSHER_BATCH_PAGES];
+    uint32_t numPages = 0;
+    for (uint32_t pass = 0; pass < 2 && numPages == 0; pass++) {
+        if (pass == 1) {
+            if (pager->FlushCursor == 0) {
+                break;
+            }
+            pager->FlushCursor = 0;
+        }
+        if (pager->Mapping != NULL) {
+            for (uint32_t i = pager->FlushCursor; i < pager->NumPages && numPages < FLUSHER_BATCH_PAGES && pager->MappedPins == 0; i++) {
+                if ((pager->PageFlags[i] & (PAGE_DIRTY | PAGE_LOG_PENDING)) == PAGE_DIRTY) {
+                    pages[numPages++] = i;
+                }
+            }
+        } else {
+            numPages = CollectDirtyFrames(pager, pager->FlushCursor, true);
+            if (numPages > FLUSHER_BATCH_PAGES) {
+                numPages = FLUSHER_BATCH_PAGES;
+            }
+            memcpy(pages, pager->FlushCandidates, numPages * sizeof(uint32_t));
+        }
+    }
+    if (numPages == 0) {
+        return 0;
+    }
+
+    // * Clearing LogPending takes Lock, so every version of these pages is in
+    // * the log and covered by this sync
+    Wal* wal = pager->Wal;
+    pthread_mutex_lock(&wal->Lock);
+    bool due = wal->UnsyncedCommits == 0 || ElapsedMs(&wal->FirstUnsyncedAt) >= wal->CommitIntervalMs;
+    if (due) {
+        WalSync(wal);
+    }
+    pthread_mutex_unlock(&wal->Lock);
+    if (!due) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < numPages; i++) {
+        FlushPager(pager, pages[i]);
+    }
+    pager->FlushCursor = pages[numPages - 1] + 1;
+    return numPages;
+}
+
+// * Sleeps long enough after each batch to keep to FlushRatePages, and for
+// * FLUSHER_IDLE_MS when there was nothing it could write
+void* FlusherWorker(void* argument) {
+    Pager* pager = argument;
+    pthread_mutex_lock(&pager->Lock);
+    while (!pager->Stopping) {
+        uint32_t numFlushed = FlushDirtyBatch(pager);
+        uint64_t waitNs = numFlushed > 0 ? (uint64_t)numFlushed * 1000000000 / pager->FlushRatePages : (uint64_t)FLUSHER_IDLE_MS * 1000000;
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        waitNs += deadline.tv_nsec;
+        deadline.tv_sec += waitNs / 1000000000;
+        deadline.tv_nsec = waitNs % 1000000000;
+        while (!pager->Stopping && pthread_cond_timedwait(&pager->FlusherWake, &pager->Lock, &deadline) != ETIMEDOUT) {
+        }
+    }
+    pthread_mutex_unlock(&pager->Lock);
+    return NULL;
+}
+
+// * Writes back every dirty page, makes the database file durable and then
+// * drops the log, which no longer holds anything the file lacks.
+uint32_t CheckpointPager(Pager* pager) {
+    pthread_mutex_lock(&pager->Lock);
+    pthread_mutex_lock(&pager->Wal->Lock);
+    WalSync(pager->Wal);
+
+    uint32_t numFlushed = pager->Mapping == NULL ? CollectDirtyFrames(pager, 0, false) : 0;
+    for (uint32_t i = 0; i < numFlushed; i++) {
+        FlushPager(pager, pager->FlushCandidates[i]);
+    }
+    uint32_t numMappedPages = pager->Mapping != NULL ? pager->NumPages : 0;
+    for (uint32_t i = 0; i < numMappedPages; i++) {
+        if (pager->PageFlags[i] & PAGE_DIRTY) {
+            FlushPager(pager, i);
+            numFlushed++;
+        }
+    }
+
+    if (fsync(pager->FileDescriptor) == -1) {
+        printf("Error syncing db file: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    WalTruncate(pager->Wal);
+
+    // * The file now matches every private copy, so let the mapping share the
+    // * page cache again instead of holding anonymous memory.
+    if (numMappedPages > 0 && pager->MappedPins == 0) {
+        madvise(pager->Mapping, (size_t)numMappedPages * PAGE_SIZE, MADV_DONTNEED);
+    }
+    pthread_mutex_unlock(&pager->Wal->Lock);
+    pthread_mutex_unlock(&pager->Lock);
+    return numFlushed;
+}
+
+void* VerifyWorker(void* argument) {
+    PagerVerification* verification = argument;
+    Pager* pager = verification->Pager;
+    void* buffer = aligned_alloc(PAGE_SIZE, (size_t)VERIFY_CHUNK_PAGES * PAGE_SIZE);
+    while (true) {
+        uint32_t first = __atomic_fetch_add(&verification->NextChunk, 1, __ATOMIC_RELAXED) * VERIFY_CHUNK_PAGES;
+        if (first >= verification->NumPages) {
+            break;
+        }
+        uint32_t numPages = verification->NumPages - first < VERIFY_CHUNK_PAGES ? verification->NumPages - first : VERIFY_CHUNK_PAGES;
+        struct iovec vector = {buffer, (size_t)numPages * PAGE_SIZE};
+        size_t bytesRead = ReadPagesAt(pager->FileDescriptor, &vector, 1, (off_t)first * PAGE_SIZE);
+        memset(buffer + bytesRead, 0, (size_t)numPages * PAGE_SIZE - bytesRead);
+
+        for (uint32_t i = 0; i < numPages; i++) {
+            void* page = buffer + (size_t)i * PAGE_SIZE;
+            EPageCheck check = CheckPage(page);
+            if (check == PAGE_CHECK_CORRUPT) {
+                // * The read may have raced a write back of the page, so read
+                // * it again with Lock held, which FlushPager writes under
+                struct iovec pageVector = {page, PAGE_SIZE};
+                pthread_mutex_lock(&pager->Lock);
+                bytesRead = ReadPagesAt(pager->FileDescriptor, &pageVector, 1, (off_t)(first + i) * PAGE_SIZE);
+                pthread_mutex_unlock(&pager->Lock);
+                memset(page + bytesRead, 0, PAGE_SIZE - bytesRead);
+                check = CheckPage(page);
+            }
+            if (check == PAGE_CHECK_CORRUPT) {
+                printf("Page %d failed its checksum.\n", first + i);
+                __atomic_fetch_add(&verification->NumCorrupt, 1, __ATOMIC_RELAXED);
+            } else if (check == PAGE_CHECK_UNUSED) {
+                __atomic_fetch_add(&verification->NumUnused, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+// * Checks every page of the database against its checksum as the file has
+// * it, reading chunks of it on numThreads threads alongside other sessions.
+// * Callers checkpoint first, so pages only the buffer pool or the memory map
+// * holds are written back and checked too; a page allocated but never written
+// * counts as unused. Returns the number that failed, each of which is printed.
+uint32_t VerifyPager(Pager* pager, uint32_t numThreads, uint32_t* numPages, uint32_t* numUnused) {
+    PagerVerification verification;
+    verification.Pager = pager;
+    pthread_mutex_lock(&pager->Lock);
+    verification.NumPages = pager->NumPages;
+    pthread_mutex_unlock(&pager->Lock);
+    verification.NextChunk = 0;
+    verification.NumCorrupt = 0;
+    verification.NumUnused = 0;
+
+    uint32_t numChunks = (verification.NumPages + VERIFY_CHUNK_PAGES - 1) / VERIFY_CHUNK_PAGES;
+    numThreads = numThreads < numChunks ? numThreads : numChunks;
+    numThreads = numThreads < VERIFY_MAX_THREADS ? numThreads : VERIFY_MAX_THREADS;
+    numThreads = numThreads > 0 ? numThreads : 1;
+    pthread_t workers[VERIFY_MAX_THREADS];
+    for (uint32_t i = 1; i < numThreads; i++) {
+        if (pthread_create(&workers[i], NULL, VerifyWorker, &verification) != 0) {
+            printf("Unable to start verify thread %d of %d.\n", i + 1, numThreads);
+            exit(EXIT_FAILURE);
+        }
+    }
+    VerifyWorker(&verification);
+    for (uint32_t i = 1; i < numThreads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    *numPages = verification.NumPages;
+    *numUnused = verification.NumUnused;
+    return verification.NumCorrupt;
+}
+
+// * Copies the committed images of spilled pages from the synced log into the
+// * database file, where misses find them from now on. Callers hold Lock.
+void WriteBackSpilledPages(Pager* pager) {
+    void* page = NULL;
+    for (uint32_t i = 0; i < pager->NumSpilledPages; i++) {
+        if (page == NULL) {
+            page = aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        }
+        SpilledPage* spilled = &pager->SpilledPages[i];
+        struct iovec vector = {page, PAGE_SIZE};
+        pthread_mutex_lock(&pager->Wal->Lock);
+        size_t bytesRead = ReadPagesAt(pager->Wal->FileDescriptor, &vector, 1, spilled->Offset);
+        pthread_mutex_unlock(&pager->Wal->Lock);
+        if (bytesRead != PAGE_SIZE) {
+            printf("Error reading spilled page %d from write-ahead log: %d\n", spilled->PageNum, errno);
+            exit(EXIT_FAILURE);
+        }
+
+        StampPageChecksum(page);
+        off_t offset = (off_t)spilled->PageNum * PAGE_SIZE;
+        if (pwrite(pager->FileDescriptor, page, PAGE_SIZE, offset) != PAGE_SIZE) {
+            printf("Error writing: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        Stats.PagesFlushed += 1;
+        Stats.BytesFlushed += PAGE_SIZE;
+        if (offset + PAGE_SIZE > pager->FileLength) {
+            pager->FileLength = offset + PAGE_SIZE;
+        }
+    }
+    free(page);
+    pager->NumSpilledPages = 0;
+}
+
+// * Ends a statement: appends the after-image of every page it modified and
+// * then a COMMIT record, so the statement survives the process dying. Recovery
+// * ignores images no COMMIT follows, so a batch cut short by a crash is lost
+// * whole however many writes it took.
+// * The fdatasync that makes it survive a power loss is shared by up to
+// * CommitBatch statements or CommitIntervalMs, whichever comes first; the
+// * log's sync thread covers the interval when no statement follows.
+// * The log is written without Lock held, so readers keep fetching pages; the
+// * pages being logged stay log-pending until then, which keeps them resident.
+// * Pages the statement spilled are already in the log ahead of its COMMIT,
+// * which counts them, so a crash keeps or drops the statement as a whole.
+void CommitPager(Pager* pager) {
+    pthread_mutex_lock(&pager->Lock);
+    uint32_t numPages = pager->NumPendingPages;
+    uint32_t numSpilled = pager->NumSpilledRecords;
+    ReserveMappedPages(pager);
+    if (numPages == 0 && numSpilled == 0) {
+        pthread_mutex_unlock(&pager->Lock);
+        return;
+    }
+    pager->Committing = true;
+
+    Wal* wal = pager->Wal;
+    WalRecordHeader* headers = malloc((numPages + 1) * sizeof(WalRecordHeader));
+    struct iovec* vectors = malloc((2 * numPages + 1) * sizeof(struct iovec));
+
+    for (uint32_t i = 0; i < numPages; i++) {
+        vectors[2 * i].iov_base = &headers[i];
+        vectors[2 * i].iov_len = sizeof(WalRecordHeader);
+        vectors[2 * i + 1].iov_base = ResidentPageData(pager, pager->PendingPages[i]);
+        vectors[2 * i + 1].iov_len = PAGE_SIZE;
+    }
+    pthread_mutex_unlock(&pager->Lock);
+
+    pthread_mutex_lock(&wal->Lock);
+    for (uint32_t i = 0; i < numPages; i++) {
+        headers[i].Type = WAL_RECORD_PAGE;
+        headers[i].PageNum = pager->PendingPages[i];
+        headers[i].Sequence = wal->NextSequence++;
+        headers[i].Reserved = 0;
+        headers[i].Checksum = WalRecordChecksum(&headers[i], vectors[2 * i + 1].iov_base, PAGE_SIZE);
+    }
+
+    WalRecordHeader* commit = &headers[numPages];
+    commit->Type = WAL_RECORD_COMMIT;
+    commit->PageNum = numPages + numSpilled;
+    commit->Sequence = wal->NextSequence++;
+    commit->Reserved = 0;
+    commit->Checksum = WalRecordChecksum(commit, NULL, 0);
+    vectors[2 * numPages].iov_base = commit;
+    vectors[2 * numPages].iov_len = sizeof(WalRecordHeader);
+
+    uint64_t startedAt = StatsNow();
+    WalWrite(wal, vectors, 2 * (size_t)numPages + 1);
+    StatsRecord(STATS_WAL_WRITE, startedAt);
+    free(headers);
+    free(vectors);
+
+    if (wal->UnsyncedCommits == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &wal->FirstUnsyncedAt);
+        pthread_cond_signal(&wal->SyncerWake);
+    }
+    wal->UnsyncedCommits += 1;
+
+    if (wal->UnsyncedCommits >= wal->CommitBatch || ElapsedMs(&wal->FirstUnsyncedAt) >= wal->CommitIntervalMs) {
+        WalSync(wal);
+    }
+    if (pager->NumSpilledPages > 0) {
+        WalSync(wal);
+    }
+    bool checkpoint = wal->FileLength >= wal->CheckpointBytes;
+    pthread_mutex_unlock(&wal->Lock);
+
+    pthread_mutex_lock(&pager->Lock);
+    for (uint32_t i = 0; i < numPages; i++) {
+        uint32_t pageNum = pager->PendingPages[i];
+        if (pager->Mapping != NULL) {
+            pager->PageFlags[pageNum] &= ~PAGE_LOG_PENDING;
+        } else {
+            GetFrame(pager, pageNum)->LogPending = false;
+        }
+    }
+    pager->NumPendingPages = 0;
+    WriteBackSpilledPages(pager);
+    pager->NumSpilledRecords = 0;
+    pager->Committing = false;
+    pthread_cond_broadcast(&pager->PageLoaded);
+    pthread_mutex_unlock(&pager->Lock);
+
+    if (checkpoint) {
+        CheckpointPager(pager);
+    }
+}
+
+// * Returns the page number one past the end of the file. AllocatePage takes
+// * it when the free list is empty; the page is only claimed once it is fetched.
+uint32_t GetUnusedPageNum(Pager* pager) {
+    pthread_mutex_lock(&pager->Lock);
+    uint32_t pageNum = pager->NumPages;
+    pthread_mutex_unlock(&pager->Lock);
+    return pageNum;
+}
+
+// * Checkpoints, so a clean close leaves no log behind, and releases the pager
+void ClosePager(Pager* pager) {
+    pthread_mutex_lock(&pager->Lock);
+    pager->Stopping = true;
+    pthread_cond_broadcast(&pager->ReadQueued);
+    pthread_cond_signal(&pager->FlusherWake);
+    pthread_mutex_unlock(&pager->Lock);
+    for (uint32_t i = 0; i < READAHEAD_THREADS && pager->ReadAheadPages > 0; i++) {
+        pthread_join(pager->ReadThreads[i], NULL);
+    }
+    if (pager->FlushRatePages > 0) {
+        pthread_join(pager->Flusher, NULL);
+    }
+
+    CheckpointPager(pager);
+    CloseWal(pager->Wal);
+    if (pager->Mapping != NULL) {
+        UnmapPager(pager);
+    }
+
+    int result = close(pager->FileDescriptor);
+    if (result == -1) {
+        printf("Error closing db file.\n");
+        exit(EXIT_FAILURE);
+    }
+    free(pager->Arena);
+    free(pager->Frames);
+    free(pager->PageTable);
+    free(pager->PendingPages);
+    free(pager->SpilledPages);
+    free(pager->ReadQueue);
+    free(pager->FlushCandidates);
+    for (uint32_t i = 0; i <= UINT32_MAX / PAGE_LATCH_CHUNK; i++) {
+        if (pager->Latches[i] == NULL) {
+            continue;
+        }
+        for (uint32_t j = 0; j < PAGE_LATCH_CHUNK; j++) {
+            pthread_rwlock_destroy(&pager->Latches[i][j]);
+        }
+        free(pager->Latches[i]);
+    }
+    free(pager->Latches);
+    pthread_cond_destroy(&pager->ReadQueued);
+    pthread_cond_destroy(&pager->PageLoaded);
+    pthread_cond_destroy(&pager->FlusherWake);
+    pthread_mutex_destroy(&pager->Lock);
+    free(pager);
+}
@@ -0,0 +1,44 @@
+#include "row.h"
+
+#include <string.h>
+
+// * Writes the cell for a row from its fields and returns the cell length
+uint32_t SerializeRowFields(void* destination, const char* username, size_t usernameLength, const char* email, size_t emailLength) {
+    uint8_t* cell = destination;
+    cell[0] = (uint8_t)usernameLength;
+    memcpy(cell + CELL_LENGTH_PREFIX_SIZE, username, usernameLength);
+    cell += CELL_LENGTH_PREFIX_SIZE + usernameLength;
+    cell[0] = (uint8_t)emailLength;
+    memcpy(cell + CELL_LENGTH_PREFIX_SIZE, email, emailLength);
+    return 2 * CELL_LENGTH_PREFIX_SIZE + usernameLength + emailLength;
+}
+
+uint32_t SerializeRow(Row* source, void* destination) {
+    return SerializeRowFields(destination, source->Username, strlen(source->Username), source->Email, strlen(source->Email));
+}
+
+// * Points at the length-prefixed fields of a cell without copying them
+void CellFields(void* source, const char** username, uint32_t* usernameLength, const char** email, uint32_t* emailLength) {
+    uint8_t* cell = source;
+    *usernameLength = cell[0];
+    *username = (const char*)cell + CELL_LENGTH_PREFIX_SIZE;
+    cell += CELL_LENGTH_PREFIX_SIZE + *usernameLength;
+    *emailLength = cell[0];
+    *email = (const char*)cell + CELL_LENGTH_PREFIX_SIZE;
+}
+
+void DeserializeRow(uint32_t key, void* source, Row* destination) {
+    const char *username, *email;
+    uint32_t usernameLength, emailLength;
+    CellFields(source, &username, &usernameLength, &email, &emailLength);
+
+    destination->ID = key;
+    memcpy(destination->Username, username, usernameLength);
+    destination->Username[usernameLength] = 0;
+    memcpy(destination->Email, email, emailLength);
+    destination->Email[emailLength] = 0;
+}
+
+void PrintRow(Row* row) {
+    printf("%d, %s, %s\n", row->ID, row->Username, row->Email);
+}
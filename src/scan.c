@@ -0,0 +1,350 @@
+#include "scan.h"
+
+#include <string.h>
+
+typedef struct {
+    uint32_t KeyFrom;
+    uint32_t KeyTo;
+    bool Claimed;       // * Set atomically by the one thread that runs the task
+    bool Done;          // * Guarded by the scan's Lock
+    ResultSink* Rows;   // * Buffered rows until they are emitted, NULL for aggregates
+    ScanAggregate Aggregate;
+} ScanTask;
+
+// * Tasks [Next, End) not yet taken. The owner pops from the front and
+// * thieves take from the back.
+typedef struct {
+    pthread_mutex_t Lock;
+    uint32_t Next;
+    uint32_t End;
+} ScanDeque;
+
+typedef struct ParallelScan {
+    Statement* Statement;
+    Table* Table;
+    EOutputMode Mode;
+    ScanTask* Tasks;
+    uint32_t NumTasks;
+    ScanDeque* Deques;
+    uint32_t NumWorkers;    // * Seats, one per deque
+    uint32_t NumJoined;     // * Seats taken, each by one pool thread; guarded by the pool's Lock
+    uint32_t NumFinished;   // * Pool threads done with the scan; guarded by the pool's Lock
+    struct ParallelScan* NextQueued;
+    pthread_mutex_t Lock;   // * Guards Done, Rows, Buffered and Stopping
+    pthread_cond_t TaskDone;
+    pthread_cond_t Drained; // * Buffered fell or the scan is stopping
+    size_t Buffered;        // * Bytes of rows held by finished tasks
+    bool Stopping;          // * The reader went away; unstarted tasks are skipped
+} ParallelScan;
+
+struct ScanPool {
+    pthread_mutex_t Lock;   // * Guards the queue, the seats of queued scans and Stopping
+    pthread_cond_t Queued;  // * A scan was queued or the pool is stopping
+    pthread_cond_t Left;    // * A thread finished with a scan
+    ParallelScan* Head;     // * Scans with seats open, oldest first
+    ParallelScan* Tail;
+    pthread_t Threads[SCAN_MAX_THREADS];
+    uint32_t NumThreads;
+    bool Stopping;
+};
+
+bool ScanDequePop(ScanDeque* deque, uint32_t* taskNum) {
+    pthread_mutex_lock(&deque->Lock);
+    bool found = deque->Next < deque->End;
+    if (found) {
+        *taskNum = deque->Next++;
+    }
+    pthread_mutex_unlock(&deque->Lock);
+    return found;
+}
+
+// * Moves the back half of the victim's tasks, rounded up, into the thief's
+// * empty deque. Returns false if the victim had none left.
+bool ScanDequeSteal(ScanDeque* thief, ScanDeque* victim) {
+    pthread_mutex_lock(&victim->Lock);
+    uint32_t remaining = victim->End - victim->Next;
+    uint32_t end = victim->End;
+    victim->End -= (remaining + 1) / 2;
+    uint32_t next = victim->End;
+    pthread_mutex_unlock(&victim->Lock);
+    if (remaining == 0) {
+        return false;
+    }
+
+    pthread_mutex_lock(&thief->Lock);
+    thief->Next = next;
+    thief->End = end;
+    pthread_mutex_unlock(&thief->Lock);
+    return true;
+}
+
+// * Scans the task's key range unless another thread already claimed it
+void RunScanTask(ParallelScan* scan, uint32_t taskNum) {
+    ScanTask* task = &scan->Tasks[taskNum];
+    if (__atomic_exchange_n(&task->Claimed, true, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    ResultSink* rows = scan->Statement->NumAggregates > 0 ? NULL : OpenMemorySink(scan->Mode);
+    ScanRange(scan->Statement, scan->Table, task->KeyFrom, task->KeyTo, rows, &task->Aggregate);
+
+    pthread_mutex_lock(&scan->Lock);
+    task->Rows = rows;
+    task->Done = true;
+    if (rows != NULL) {
+        scan->Buffered += rows->Length;
+    }
+    pthread_cond_broadcast(&scan->TaskDone);
+    pthread_mutex_unlock(&scan->Lock);
+}
+
+// * Runs tasks of the scan from the deque of seat self, stealing once it is empty
+void ScanWorker(ParallelScan* scan, uint32_t self) {
+    while (true) {
+        uint32_t taskNum;
+        bool found = ScanDequePop(&scan->Deques[self], &taskNum);
+        for (uint32_t i = 1; i < scan->NumWorkers && !found; i++) {
+            if (ScanDequeSteal(&scan->Deques[self], &scan->Deques[(self + i) % scan->NumWorkers])) {
+                found = ScanDequePop(&scan->Deques[self], &taskNum);
+            }
+        }
+        if (!found) {
+            break;
+        }
+
+        pthread_mutex_lock(&scan->Lock);
+        while (scan->Buffered >= SCAN_MAX_BUFFERED && !scan->Stopping) {
+            pthread_cond_wait(&scan->Drained, &scan->Lock);
+        }
+        bool stopping = scan->Stopping;
+        pthread_mutex_unlock(&scan->Lock);
+        if (stopping) {
+            break;
+        }
+        RunScanTask(scan, taskNum);
+    }
+}
+
+// * Unlinks a scan from the queue. Callers hold the pool's Lock.
+void ScanPoolRemove(ScanPool* pool, ParallelScan* scan) {
+    ParallelScan** link = &pool->Head;
+    ParallelScan* previous = NULL;
+    while (*link != NULL && *link != scan) {
+        previous = *link;
+        link = &(*link)->NextQueued;
+    }
+    if (*link == NULL) {
+        return;
+    }
+    *link = scan->NextQueued;
+    if (pool->Tail == scan) {
+        pool->Tail = previous;
+    }
+    scan->NextQueued = NULL;
+}
+
+// * Takes the next open seat of the oldest queued scan until the pool stops
+void* ScanPoolWorker(void* argument) {
+    ScanPool* pool = argument;
+    pthread_mutex_lock(&pool->Lock);
+    while (true) {
+        while (pool->Head == NULL && !pool->Stopping) {
+            pthread_cond_wait(&pool->Queued, &pool->Lock);
+        }
+        if (pool->Head == NULL) {
+            break;
+        }
+        ParallelScan* scan = pool->Head;
+        uint32_t self = scan->NumJoined++;
+        if (scan->NumJoined == scan->NumWorkers) {
+            ScanPoolRemove(pool, scan);
+        }
+        pthread_mutex_unlock(&pool->Lock);
+
+        ScanWorker(scan, self);
+
+        pthread_mutex_lock(&pool->Lock);
+        scan->NumFinished += 1;
+        pthread_cond_broadcast(&pool->Left);
+    }
+    pthread_mutex_unlock(&pool->Lock);
+    return NULL;
+}
+
+// * Most threads a scan may use besides the calling one. Each keeps
+// * SCAN_FRAMES_PER_THREAD pool frames to itself.
+uint32_t ScanThreadLimit(Table* table) {
+    uint32_t numThreads = table->ScanThreads < SCAN_MAX_THREADS ? table->ScanThreads : SCAN_MAX_THREADS;
+    uint32_t numFrames = table->Pager->NumFrames; // * 0 in memory-mapped mode
+    if (numFrames > 0 && numThreads > numFrames / SCAN_FRAMES_PER_THREAD) {
+        numThreads = numFrames / SCAN_FRAMES_PER_THREAD;
+    }
+    return numThreads;
+}
+
+// * Returns NULL, starting no threads, when selects would not scan on two or more
+ScanPool* OpenScanPool(Table* table) {
+    uint32_t numThreads = ScanThreadLimit(table);
+    if (numThreads < 2) {
+        return NULL;
+    }
+
+    ScanPool* pool = malloc(sizeof(ScanPool));
+    pthread_mutex_init(&pool->Lock, NULL);
+    pthread_cond_init(&pool->Queued, NULL);
+    pthread_cond_init(&pool->Left, NULL);
+    pool->Head = NULL;
+    pool->Tail = NULL;
+    pool->NumThreads = numThreads;
+    pool->Stopping = false;
+    for (uint32_t i = 0; i < numThreads; i++) {
+        if (pthread_create(&pool->Threads[i], NULL, ScanPoolWorker, pool) != 0) {
+            printf("Unable to start scan thread %d of %d.\n", i + 1, numThreads);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+// * Called once no select is running
+void CloseScanPool(ScanPool* pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->Lock);
+    pool->Stopping = true;
+    pthread_cond_broadcast(&pool->Queued);
+    pthread_mutex_unlock(&pool->Lock);
+    for (uint32_t i = 0; i < pool->NumThreads; i++) {
+        pthread_join(pool->Threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->Lock);
+    pthread_cond_destroy(&pool->Queued);
+    pthread_cond_destroy(&pool->Left);
+    free(pool);
+}
+
+// * Returns false, having scanned nothing, if the select is better run on the
+// * calling thread: too few scan threads, a narrow id range or a small table.
+bool ParallelSelect(Statement* statement, Table* table, ResultSink* sink, ScanAggregate* aggregate) {
+    ScanPool* pool = table->ScanPool;
+    if (pool == NULL || statement->KeyTo - statement->KeyFrom < SCAN_MIN_PARALLEL_KEYS) {
+        return false;
+    }
+
+    // * Pieces are whole subtrees, grouped so each thread gets about
+    // * SCAN_TASKS_PER_THREAD tasks and no task is only a leaf or two
+    uint32_t numWorkers = pool->NumThreads;
+    uint32_t target = numWorkers * SCAN_TASKS_PER_THREAD;
+    uint32_t* uppers;
+    bool reachedLeaves;
+    uint32_t numPieces = TableSplitRange(table, statement->KeyFrom, statement->KeyTo, target, &uppers, &reachedLeaves);
+    uint32_t piecesPerTask = (numPieces + target - 1) / target;
+    if (reachedLeaves && piecesPerTask < SCAN_MIN_TASK_LEAVES) {
+        piecesPerTask = SCAN_MIN_TASK_LEAVES;
+    }
+    uint32_t numTasks = (numPieces + piecesPerTask - 1) / piecesPerTask;
+    if (numTasks < 2) {
+        free(uppers);
+        return false;
+    }
+    if (numWorkers > numTasks) {
+        numWorkers = numTasks;
+    }
+
+    ParallelScan scan;
+    scan.Statement = statement;
+    scan.Table = table;
+    scan.Mode = sink->Mode;
+    scan.NumTasks = numTasks;
+    scan.Tasks = calloc(numTasks, sizeof(ScanTask));
+    for (uint32_t i = 0; i < numTasks; i++) {
+        uint32_t lastPiece = (i + 1) * piecesPerTask < numPieces ? (i + 1) * piecesPerTask - 1 : numPieces - 1;
+        scan.Tasks[i].KeyFrom = i == 0 ? statement->KeyFrom : scan.Tasks[i - 1].KeyTo + 1;
+        scan.Tasks[i].KeyTo = uppers[lastPiece];
+    }
+    free(uppers);
+
+    scan.NumWorkers = numWorkers;
+    scan.NumJoined = 0;
+    scan.NumFinished = 0;
+    scan.NextQueued = NULL;
+    scan.Deques = malloc(numWorkers * sizeof(ScanDeque));
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        pthread_mutex_init(&scan.Deques[i].Lock, NULL);
+        scan.Deques[i].Next = (uint64_t)i * numTasks / numWorkers;
+        scan.Deques[i].End = (uint64_t)(i + 1) * numTasks / numWorkers;
+    }
+    pthread_mutex_init(&scan.Lock, NULL);
+    pthread_cond_init(&scan.TaskDone, NULL);
+    pthread_cond_init(&scan.Drained, NULL);
+    scan.Buffered = 0;
+    scan.Stopping = false;
+
+    pthread_mutex_lock(&pool->Lock);
+    if (pool->Tail != NULL) {
+        pool->Tail->NextQueued = &scan;
+    } else {
+        pool->Head = &scan;
+    }
+    pool->Tail = &scan;
+    pthread_cond_broadcast(&pool->Queued);
+    pthread_mutex_unlock(&pool->Lock);
+
+    // * Emit in task order, running the next task here if no worker has yet
+    for (uint32_t i = 0; i < numTasks && !sink->Disconnected; i++) {
+        ScanTask* task = &scan.Tasks[i];
+        RunScanTask(&scan, i);
+        pthread_mutex_lock(&scan.Lock);
+        while (!task->Done) {
+            pthread_cond_wait(&scan.TaskDone, &scan.Lock);
+        }
+        ResultSink* rows = task->Rows;
+        pthread_mutex_unlock(&scan.Lock);
+
+        if (rows != NULL) {
+            SinkWrite(sink, rows->Buffer, rows->Length);
+            pthread_mutex_lock(&scan.Lock);
+            scan.Buffered -= rows->Length;
+            task->Rows = NULL;
+            pthread_cond_broadcast(&scan.Drained);
+            pthread_mutex_unlock(&scan.Lock);
+            CloseResultSink(rows);
+        }
+        if (task->Aggregate.Count > 0) {
+            if (aggregate->Count == 0) {
+                aggregate->MinKey = task->Aggregate.MinKey;
+            }
+            aggregate->Count += task->Aggregate.Count;
+            aggregate->MaxKey = task->Aggregate.MaxKey;
+        }
+    }
+
+    pthread_mutex_lock(&scan.Lock);
+    scan.Stopping = true; // * Only matters if the reader went away
+    pthread_cond_broadcast(&scan.Drained);
+    pthread_mutex_unlock(&scan.Lock);
+    pthread_mutex_lock(&pool->Lock);
+    if (scan.NumJoined < scan.NumWorkers) {
+        ScanPoolRemove(pool, &scan);
+    }
+    while (scan.NumFinished < scan.NumJoined) {
+        pthread_cond_wait(&pool->Left, &pool->Lock);
+    }
+    pthread_mutex_unlock(&pool->Lock);
+
+    for (uint32_t i = 0; i < numTasks; i++) {
+        if (scan.Tasks[i].Rows != NULL) {
+            CloseResultSink(scan.Tasks[i].Rows);
+        }
+    }
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        pthread_mutex_destroy(&scan.Deques[i].Lock);
+    }
+    pthread_mutex_destroy(&scan.Lock);
+    pthread_cond_destroy(&scan.TaskDone);
+    pthread_cond_destroy(&scan.Drained);
+    free(scan.Deques);
+    free(scan.Tasks);
+    return true;
+}
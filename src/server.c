@@ -0,0 +1,288 @@
+#include "server.h"
+#include "statement.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+void SessionPrintf(ResultSink* sink, const char* format, ...) {
+    char message[SESSION_MESSAGE_SIZE];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+    if (length >= (int)sizeof(message)) {
+        length = sizeof(message) - 1;
+    }
+    SinkWrite(sink, message, length);
+}
+
+// * Runs one line of a session. Returns false once the client asks to leave.
+bool SessionExecute(Table* table, ResultSink* sink, PreparedStatements* prepared, char* line, size_t length) {
+    Statement statement;
+    EPrepareResult prepareResult;
+    bool prepareOnly = strncmp(line, ".prepare ", 9) == 0;
+    if (prepareOnly) {
+        prepareResult = PrepareNamed(prepared, line + 9);
+    } else if (strncmp(line, ".exec ", 6) == 0) {
+        prepareResult = BindPrepared(prepared, line + 6, &statement);
+    } else if (line[0] == '.') {
+        if (strcmp(line, ".exit") == 0) {
+            return false;
+        } else if (strncmp(line, ".mode ", 6) == 0) {
+            const char* mode = line + 6;
+            if (strcmp(mode, "text") == 0) {
+                sink->Mode = OUTPUT_MODE_TEXT;
+            } else if (strcmp(mode, "csv") == 0) {
+                sink->Mode = OUTPUT_MODE_CSV;
+            } else if (strcmp(mode, "binary") == 0) {
+                sink->Mode = OUTPUT_MODE_BINARY;
+            } else {
+                SessionPrintf(sink, "Unknown output mode '%s'. Use text, csv or binary.\n", mode);
+            }
+        } else {
+            SessionPrintf(sink, "Unrecognized command '%s'.\n", line);
+        }
+        return true;
+    } else {
+        InputBuffer inputBuffer;
+        inputBuffer.Buffer = line;
+        inputBuffer.BufferLength = length + 1;
+        inputBuffer.InputLength = length;
+        prepareResult = PrepareStatement(&inputBuffer, &statement);
+    }
+
+    switch (prepareResult) {
+    case (PREPARE_SUCCESS):
+        break;
+    case (PREPARE_NEGATIVE_ID):
+        SessionPrintf(sink, "ID must be positive.\n");
+        return true;
+    case (PREPARE_STRING_TOO_LONG):
+        SessionPrintf(sink, "String is too long.\n");
+        return true;
+    case (PREPARE_SYNTAX_ERROR):
+        SessionPrintf(sink, "Syntax error. Could not parse statement.\n");
+        return true;
+    case (PREPARE_UNRECOGNIZED_STATEMENT):
+        SessionPrintf(sink, "Unrecognized keyword at start of '%s'.\n", line);
+        return true;
+    case (PREPARE_TOO_MANY_ROWS):
+        SessionPrintf(sink, "Too many rows. An insert takes at most %d.\n", INSERT_MAX_ROWS);
+        return true;
+    case (PREPARE_UNKNOWN_NAME):
+        SessionPrintf(sink, "Unknown prepared statement.\n");
+        return true;
+    case (PREPARE_PARAMETER_COUNT):
+        SessionPrintf(sink, "Wrong number of parameters.\n");
+        return true;
+    }
+    if (prepareOnly) {
+        return true;
+    }
+
+    switch (ExecuteStatement(&statement, table, sink)) {
+    case (EXECUTE_SUCCESS):
+        SessionPrintf(sink, "Executed.\n");
+        break;
+    case (EXECUTE_DUPLICATE_KEY):
+        SessionPrintf(sink, "Error: Duplicate key.\n");
+        break;
+    case (EXECUTE_TABLE_FULL):
+        SessionPrintf(sink, "Error: Table full.\n");
+        break;
+    case (EXECUTE_INDEX_EXISTS):
+        SessionPrintf(sink, "Error: Index already exists.\n");
+        break;
+    }
+    return true;
+}
+
+// * Reads lines from the client until it leaves or the connection is shut
+// * down. Each response, prompt included, goes out in one flush.
+void RunSession(Table* table, int fileDescriptor) {
+    ResultSink* sink = OpenResultSink();
+    SinkRedirect(sink, fileDescriptor, false);
+    PreparedStatements* prepared = NewPreparedStatements();
+    size_t capacity = SESSION_BUFFER_SIZE;
+    size_t length = 0;
+    char* buffer = malloc(capacity);
+    bool open = true;
+
+    SinkWrite(sink, "db > ", 5);
+    SinkFlush(sink);
+    while (open && !sink->Disconnected) {
+        char* newline = memchr(buffer, '\n', length);
+        if (newline == NULL) {
+            if (length == capacity) {
+                if (capacity >= SESSION_MAX_LINE) {
+                    SessionPrintf(sink, "Line is longer than %d bytes.\n", SESSION_MAX_LINE);
+                    break;
+                }
+                capacity *= 2;
+                buffer = realloc(buffer, capacity);
+            }
+            ssize_t bytesRead = read(fileDescriptor, buffer + length, capacity - length);
+            if (bytesRead == -1 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead <= 0) {
+                break;
+            }
+            length += bytesRead;
+            continue;
+        }
+
+        size_t lineLength = newline - buffer;
+        *newline = '\0';
+        if (lineLength > 0 && buffer[lineLength - 1] == '\r') {
+            buffer[--lineLength] = '\0';
+        }
+        open = SessionExecute(table, sink, prepared, buffer, lineLength);
+        length -= lineLength + 1;
+        memmove(buffer, newline + 1, length);
+        if (open) {
+            SinkWrite(sink, "db > ", 5);
+        }
+        SinkFlush(sink);
+    }
+
+    free(buffer);
+    ClosePreparedStatements(prepared);
+    CloseResultSink(sink);
+}
+
+// * Records the connection a worker serves so shutdown can interrupt it.
+// * Returns its slot, or -1 if the server is already stopping.
+int32_t AddSession(Server* server, int fileDescriptor) {
+    int32_t slot = -1;
+    pthread_mutex_lock(&server->Lock);
+    for (uint32_t i = 0; i < server->NumWorkers && !server->Stopping; i++) {
+        if (server->SessionFileDescriptors[i] == -1) {
+            server->SessionFileDescriptors[i] = fileDescriptor;
+            slot = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->Lock);
+    return slot;
+}
+
+void RemoveSession(Server* server, int32_t slot) {
+    pthread_mutex_lock(&server->Lock);
+    server->SessionFileDescriptors[slot] = -1;
+    pthread_mutex_unlock(&server->Lock);
+}
+
+void* ServerWorker(void* argument) {
+    Server* server = argument;
+    while (true) {
+        int fileDescriptor = accept4(server->ListenFileDescriptor, NULL, NULL, SOCK_CLOEXEC);
+        if (fileDescriptor == -1) {
+            pthread_mutex_lock(&server->Lock);
+            bool stopping = server->Stopping;
+            pthread_mutex_unlock(&server->Lock);
+            if (stopping) {
+                break;
+            }
+            if (errno != EINTR && errno != ECONNABORTED) {
+                printf("Error accepting connection: %d\n", errno);
+            }
+            continue;
+        }
+
+        int32_t slot = AddSession(server, fileDescriptor);
+        if (slot < 0) {
+            close(fileDescriptor);
+            break;
+        }
+        RunSession(server->Table, fileDescriptor);
+        RemoveSession(server, slot);
+        close(fileDescriptor);
+    }
+    return NULL;
+}
+
+// * Serves sessions on a Unix domain socket until SIGINT or SIGTERM, then
+// * stops accepting, cuts off open sessions once their statement finishes and
+// * waits for every worker before returning, so the caller can close the table.
+void RunServer(Table* table, const char* socketPath, uint32_t numWorkers) {
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        printf("Socket path '%s' is too long.\n", socketPath);
+        exit(EXIT_FAILURE);
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    int listenFileDescriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFileDescriptor == -1) {
+        printf("Unable to create socket: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    unlink(socketPath); // * Left behind by a server that did not stop cleanly
+    if (bind(listenFileDescriptor, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(listenFileDescriptor, SERVER_LISTEN_BACKLOG) == -1) {
+        printf("Unable to listen on '%s': %d\n", socketPath, errno);
+        exit(EXIT_FAILURE);
+    }
+
+    // * A client that disconnects mid-response shows up as EPIPE in its sink.
+    // * Workers inherit a mask blocking the stop signals, so only sigwait
+    // * below receives them.
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    Server server;
+    server.Table = table;
+    server.ListenFileDescriptor = listenFileDescriptor;
+    server.NumWorkers = numWorkers;
+    server.Workers = malloc(numWorkers * sizeof(pthread_t));
+    pthread_mutex_init(&server.Lock, NULL);
+    server.Stopping = false;
+    server.SessionFileDescriptors = malloc(numWorkers * sizeof(int));
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        server.SessionFileDescriptors[i] = -1;
+    }
+
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        if (pthread_create(&server.Workers[i], NULL, ServerWorker, &server) != 0) {
+            printf("Unable to start worker %d of %d.\n", i + 1, numWorkers);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Listening on %s with %d workers.\n", socketPath, numWorkers);
+    fflush(stdout);
+
+    int received;
+    sigwait(&stopSignals, &received);
+
+    // * Shutting the listening socket down wakes workers blocked in accept
+    pthread_mutex_lock(&server.Lock);
+    server.Stopping = true;
+    shutdown(listenFileDescriptor, SHUT_RDWR);
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        if (server.SessionFileDescriptors[i] != -1) {
+            shutdown(server.SessionFileDescriptors[i], SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&server.Lock);
+
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        pthread_join(server.Workers[i], NULL);
+    }
+    close(listenFileDescriptor);
+    unlink(socketPath);
+    pthread_mutex_destroy(&server.Lock);
+    free(server.Workers);
+    free(server.SessionFileDescriptors);
+    printf("Server stopped.\n");
+}
@@ -0,0 +1,166 @@
+#include "sink.h"
+
+#include "row.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+ResultSink* OpenResultSink() {
+    ResultSink* sink = malloc(sizeof(ResultSink));
+    sink->FileDescriptor = STDOUT_FILENO;
+    sink->OwnsFileDescriptor = false;
+    sink->Disconnected = false;
+    sink->Mode = OUTPUT_MODE_TEXT;
+    sink->Buffer = malloc(OUTPUT_BUFFER_SIZE);
+    sink->Length = 0;
+    sink->Capacity = OUTPUT_BUFFER_SIZE;
+    return sink;
+}
+
+ResultSink* OpenMemorySink(EOutputMode mode) {
+    ResultSink* sink = OpenResultSink();
+    sink->FileDescriptor = -1;
+    sink->Mode = mode;
+    sink->Buffer = realloc(sink->Buffer, MEMORY_SINK_INITIAL_SIZE);
+    sink->Capacity = MEMORY_SINK_INITIAL_SIZE;
+    return sink;
+}
+
+// * A reader that went away, such as a client that disconnected, is not an
+// * error: the output is dropped and the sink marked disconnected.
+void SinkFlush(ResultSink* sink) {
+    if (sink->FileDescriptor == -1) {
+        return;
+    }
+    size_t written = 0;
+    while (written < sink->Length && !sink->Disconnected) {
+        ssize_t bytesWritten = write(sink->FileDescriptor, sink->Buffer + written, sink->Length - written);
+        if (bytesWritten == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesWritten == -1 && (errno == EPIPE || errno == ECONNRESET)) {
+            sink->Disconnected = true;
+            break;
+        }
+        if (bytesWritten == -1) {
+            printf("Error writing output: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        written += bytesWritten;
+    }
+    sink->Length = 0;
+}
+
+// * Sends later output to the file descriptor, flushing what is buffered for the old one
+void SinkRedirect(ResultSink* sink, int fileDescriptor, bool ownsFileDescriptor) {
+    SinkFlush(sink);
+    if (sink->OwnsFileDescriptor) {
+        close(sink->FileDescriptor);
+    }
+    sink->FileDescriptor = fileDescriptor;
+    sink->OwnsFileDescriptor = ownsFileDescriptor;
+    sink->Disconnected = false;
+}
+
+void CloseResultSink(ResultSink* sink) {
+    SinkRedirect(sink, STDOUT_FILENO, false);
+    free(sink->Buffer);
+    free(sink);
+}
+
+// * Returns room for length more bytes, flushing first if the buffer is too
+// * full, or growing it for a memory sink. Length must fit in an empty buffer.
+char* SinkReserve(ResultSink* sink, size_t length) {
+    if (sink->Length + length > sink->Capacity && sink->FileDescriptor == -1) {
+        while (sink->Length + length > sink->Capacity) {
+            sink->Capacity *= 2;
+        }
+        sink->Buffer = realloc(sink->Buffer, sink->Capacity);
+    } else if (sink->Length + length > sink->Capacity) {
+        SinkFlush(sink);
+    }
+    char* destination = sink->Buffer + sink->Length;
+    sink->Length += length;
+    return destination;
+}
+
+void SinkWrite(ResultSink* sink, const void* data, size_t length) {
+    // * Whatever does not fit, such as the contents of a memory sink, goes
+    // * through the buffer a full buffer at a time
+    while (sink->FileDescriptor != -1 && sink->Length + length > sink->Capacity) {
+        size_t part = sink->Capacity - sink->Length;
+        memcpy(sink->Buffer + sink->Length, data, part);
+        sink->Length += part;
+        SinkFlush(sink);
+        data += part;
+        length -= part;
+    }
+    memcpy(SinkReserve(sink, length), data, length);
+}
+
+void SinkUnsigned(ResultSink* sink, uint64_t value) {
+    char digits[20];
+    uint32_t numDigits = 0;
+    do {
+        digits[sizeof(digits) - 1 - numDigits++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    SinkWrite(sink, digits + sizeof(digits) - numDigits, numDigits);
+}
+
+// * Quotes the field only if it holds a separator, quote or line break
+void SinkCsvField(ResultSink* sink, const char* field, uint32_t length) {
+    bool quote = false;
+    for (uint32_t i = 0; i < length && !quote; i++) {
+        quote = field[i] == ',' || field[i] == '"' || field[i] == '\n' || field[i] == '\r';
+    }
+    if (!quote) {
+        SinkWrite(sink, field, length);
+        return;
+    }
+
+    SinkWrite(sink, "\"", 1);
+    for (uint32_t i = 0; i < length; i++) {
+        if (field[i] == '"') {
+            SinkWrite(sink, "\"", 1);
+        }
+        SinkWrite(sink, field + i, 1);
+    }
+    SinkWrite(sink, "\"", 1);
+}
+
+// * Writes a serialized row straight from the page into the output buffer
+void SinkRow(ResultSink* sink, uint32_t key, void* source) {
+    const char *username, *email;
+    uint32_t usernameLength, emailLength;
+    CellFields(source, &username, &usernameLength, &email, &emailLength);
+
+    switch (sink->Mode) {
+    case (OUTPUT_MODE_TEXT):
+        SinkUnsigned(sink, key);
+        SinkWrite(sink, ", ", 2);
+        SinkWrite(sink, username, usernameLength);
+        SinkWrite(sink, ", ", 2);
+        SinkWrite(sink, email, emailLength);
+        SinkWrite(sink, "\n", 1);
+        break;
+    case (OUTPUT_MODE_CSV):
+        SinkUnsigned(sink, key);
+        SinkWrite(sink, ",", 1);
+        SinkCsvField(sink, username, usernameLength);
+        SinkWrite(sink, ",", 1);
+        SinkCsvField(sink, email, emailLength);
+        SinkWrite(sink, "\n", 1);
+        break;
+    case (OUTPUT_MODE_BINARY): {
+        uint16_t cellLength = 2 * CELL_LENGTH_PREFIX_SIZE + usernameLength + emailLength;
+        uint16_t recordLength = sizeof(key) + cellLength;
+        char* destination = SinkReserve(sink, sizeof(recordLength) + recordLength);
+        memcpy(destination, &recordLength, sizeof(recordLength));
+        memcpy(destination + sizeof(recordLength), &key, sizeof(key));
+        memcpy(destination + sizeof(recordLength) + sizeof(key), source, cellLength);
+        break;
+    }
+    }
+}
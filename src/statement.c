@@ -0,0 +1,880 @@
+#include "index.h"
+#include "scan.h"
+#include "statement.h"
+#include "stats.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// * Parses a row ID of exactly length digits
+EPrepareResult ParseIdentifier(const char* value, uint32_t length, uint32_t* identifier) {
+    if (length > 1 && value[0] == '-' && value[1] >= '0' && value[1] <= '9') {
+        return PREPARE_NEGATIVE_ID;
+    }
+    if (length == 0) {
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    uint64_t parsed = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        if (value[i] < '0' || value[i] > '9') {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        parsed = parsed * 10 + (value[i] - '0');
+        if (parsed > UINT32_MAX) {
+            return PREPARE_SYNTAX_ERROR;
+        }
+    }
+    *identifier = (uint32_t)parsed;
+    return PREPARE_SUCCESS;
+}
+
+// * Parses the value of a username or email predicate, already cut out of
+// * its quotes by ScanValue. `=` matches it exactly; `like` treats a leading
+// * or trailing % as a wildcard.
+EPrepareResult ParseStringPredicate(const char* operator, const char* value, uint32_t length, uint32_t columnSize, StringPredicate* predicate) {
+    if (predicate->Match != STRING_MATCH_ANY) {
+        return PREPARE_SYNTAX_ERROR; // * one predicate per string column
+    }
+
+    if (strcmp(operator, "=") == 0) {
+        predicate->Match = STRING_MATCH_EQUAL;
+    } else if (strcmp(operator, "like") == 0) {
+        bool leading = length > 0 && value[0] == '%';
+        if (leading) {
+            value += 1;
+            length -= 1;
+        }
+        bool trailing = length > 0 && value[length - 1] == '%';
+        if (trailing) {
+            length -= 1;
+        }
+        if (memchr(value, '%', length) != NULL) {
+            return PREPARE_SYNTAX_ERROR;
+        }
+
+        if (leading && trailing) {
+            predicate->Match = STRING_MATCH_CONTAINS;
+        } else if (leading) {
+            predicate->Match = STRING_MATCH_SUFFIX;
+        } else if (trailing) {
+            predicate->Match = STRING_MATCH_PREFIX;
+        } else {
+            predicate->Match = STRING_MATCH_EQUAL;
+        }
+    } else {
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    if (length > columnSize) {
+        return PREPARE_STRING_TOO_LONG;
+    }
+    memcpy(predicate->Pattern, value, length);
+    predicate->Pattern[length] = '\0';
+    predicate->PatternLength = length;
+    return PREPARE_SUCCESS;
+}
+
+// * Narrows the statement's key range by one id comparison
+EPrepareResult ParseIdentifierPredicate(const char* operator, uint32_t value, Statement* statement) {
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+
+    if (strcmp(operator, "=") == 0) {
+        from = value;
+        to = value;
+    } else if (strcmp(operator, ">=") == 0) {
+        from = value;
+    } else if (strcmp(operator, "<=") == 0) {
+        to = value;
+    } else if (strcmp(operator, ">") == 0) {
+        if (value == UINT32_MAX) {
+            statement->KeyFrom = 1;
+            statement->KeyTo = 0;
+            return PREPARE_SUCCESS;
+        }
+        from = value + 1;
+    } else if (strcmp(operator, "<") == 0) {
+        if (value == 0) {
+            statement->KeyFrom = 1;
+            statement->KeyTo = 0;
+            return PREPARE_SUCCESS;
+        }
+        to = value - 1;
+    } else {
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    if (from > statement->KeyFrom) {
+        statement->KeyFrom = from;
+    }
+    if (to < statement->KeyTo) {
+        statement->KeyTo = to;
+    }
+    return PREPARE_SUCCESS;
+}
+
+// * Cuts the next value out of an insert's values list, a select's predicates
+// * or the arguments of `.exec`, NUL-terminating it in place. A value in
+// * single or double quotes may be empty or hold spaces, commas and
+// * parentheses. Skips the spaces after the value and returns the character
+// * that follows them in delimiter, consuming it if it is a comma or parenthesis.
+bool ScanValue(char** cursor, char** value, uint32_t* length, char* delimiter) {
+    char* position = *cursor;
+    while (*position == ' ') {
+        position++;
+    }
+
+    char* end;
+    if (*position == '\'' || *position == '"') {
+        *value = position + 1;
+        end = strchr(*value, *position);
+        if (end == NULL) {
+            return false;
+        }
+        position = end + 1;
+    } else {
+        *value = position;
+        position += strcspn(position, " ,()");
+        end = position;
+        if (end == *value) {
+            return false;
+        }
+    }
+
+    while (*position == ' ') {
+        position++;
+    }
+    *delimiter = *position;
+    if (*delimiter == ',' || *delimiter == '(' || *delimiter == ')') {
+        position++;
+    }
+    *end = '\0'; // * only now, since it may have been the delimiter
+    *length = end - *value;
+    *cursor = position;
+    return true;
+}
+
+// * A bare `?` is a parameter; a quoted one is just a question mark, and the
+// * character before a value cut out by ScanValue is its opening quote
+bool IsPlaceholder(const char* value, uint32_t length) {
+    return length == 1 && value[0] == '?' && value[-1] != '\'' && value[-1] != '"';
+}
+
+// * Cuts the next space separated word out of a select's predicates,
+// * NUL-terminating it in place. Returns NULL at the end of the text.
+char* ScanWord(char** cursor) {
+    char* position = *cursor;
+    while (*position == ' ') {
+        position++;
+    }
+    if (*position == '\0') {
+        return NULL;
+    }
+
+    char* word = position;
+    position += strcspn(position, " ");
+    if (*position == ' ') {
+        *position = '\0';
+        position++;
+    }
+    *cursor = position;
+    return word;
+}
+
+// * Cuts a predicate's value out with ScanValue, so a quoted one may hold
+// * spaces; a bare one ends at the next space
+bool ScanPredicateValue(char** cursor, char** value, uint32_t* length) {
+    char delimiter;
+    return ScanValue(cursor, value, length, &delimiter) && delimiter != ',' && delimiter != '(' && delimiter != ')';
+}
+
+EPrepareResult AddParameter(Statement* statement, EParameterTarget target, uint32_t row, const char* operator) {
+    if (statement->NumParameters == STATEMENT_MAX_PARAMETERS) {
+        return PREPARE_PARAMETER_COUNT;
+    }
+    Parameter* parameter = &statement->Parameters[statement->NumParameters++];
+    parameter->Target = target;
+    parameter->Row = row;
+    parameter->Operator = operator;
+    return PREPARE_SUCCESS;
+}
+
+// * Puts a NUL-terminated value where the parameter says, validating it as
+// * the parser would have had it been written in place of the `?`
+EPrepareResult SetParameter(Statement* statement, const Parameter* parameter, char* value, uint32_t length) {
+    RowFields* row = &statement->Rows[parameter->Row];
+    uint32_t identifier;
+    EPrepareResult result = PREPARE_SUCCESS;
+
+    switch (parameter->Target) {
+    case (PARAMETER_ID):
+        result = ParseIdentifier(value, length, &row->ID);
+        break;
+    case (PARAMETER_USERNAME):
+        if (length > COLUMN_USERNAME_SIZE) {
+            return PREPARE_STRING_TOO_LONG;
+        }
+        row->Username = value;
+        row->UsernameLength = length;
+        break;
+    case (PARAMETER_EMAIL):
+        if (length > COLUMN_EMAIL_SIZE) {
+            return PREPARE_STRING_TOO_LONG;
+        }
+        row->Email = value;
+        row->EmailLength = length;
+        break;
+    case (PARAMETER_ID_PREDICATE):
+        result = ParseIdentifier(value, length, &identifier);
+        if (result == PREPARE_SUCCESS) {
+            result = ParseIdentifierPredicate(parameter->Operator, identifier, statement);
+        }
+        break;
+    case (PARAMETER_USERNAME_PREDICATE):
+        result = ParseStringPredicate(parameter->Operator, value, length, COLUMN_USERNAME_SIZE, &statement->Username);
+        break;
+    case (PARAMETER_EMAIL_PREDICATE):
+        result = ParseStringPredicate(parameter->Operator, value, length, COLUMN_EMAIL_SIZE, &statement->Email);
+        break;
+    }
+    return result;
+}
+
+// * Sets the value of a statement's target, or records a parameter for it if the value is a `?`
+EPrepareResult ParseValue(Statement* statement, EParameterTarget target, uint32_t row, const char* operator, char* value, uint32_t length) {
+    if (IsPlaceholder(value, length)) {
+        return AddParameter(statement, target, row, operator);
+    }
+    Parameter parameter;
+    parameter.Target = target;
+    parameter.Row = row;
+    parameter.Operator = operator;
+    return SetParameter(statement, &parameter, value, length);
+}
+
+EPrepareResult ParseInsertRow(Statement* statement, char** values, uint32_t* lengths) {
+    if (statement->NumRows == INSERT_MAX_ROWS) {
+        return PREPARE_TOO_MANY_ROWS;
+    }
+    uint32_t row = statement->NumRows++;
+    EPrepareResult result = ParseValue(statement, PARAMETER_ID, row, NULL, values[0], lengths[0]);
+    if (result == PREPARE_SUCCESS) {
+        result = ParseValue(statement, PARAMETER_USERNAME, row, NULL, values[1], lengths[1]);
+    }
+    if (result == PREPARE_SUCCESS) {
+        result = ParseValue(statement, PARAMETER_EMAIL, row, NULL, values[2], lengths[2]);
+    }
+    return result;
+}
+
+// * insert ID USERNAME EMAIL
+// * insert values (ID, USERNAME, EMAIL)[, (ID, USERNAME, EMAIL)]...
+// * Values in a values list may be quoted. Any value may be a `?` in a
+// * prepared statement. The row's strings are left in the statement's text.
+EPrepareResult PrepareInsert(InputBuffer* inputBuffer, Statement* statement) {
+    statement->Type = STATEMENT_INSERT;
+
+    char* cursor = inputBuffer->Buffer + 6;
+    if (*cursor != ' ' && *cursor != '\0') {
+        return PREPARE_UNRECOGNIZED_STATEMENT;
+    }
+    while (*cursor == ' ') {
+        cursor++;
+    }
+
+    char* values[3];
+    uint32_t lengths[3];
+    if (strncmp(cursor, "values", 6) != 0 || (cursor[6] != ' ' && cursor[6] != '(')) {
+        char* save = NULL;
+        for (uint32_t i = 0; i < 3; i++) {
+            values[i] = strtok_r(i == 0 ? cursor : NULL, " ", &save);
+            if (values[i] == NULL) {
+                return PREPARE_SYNTAX_ERROR;
+            }
+            lengths[i] = strlen(values[i]);
+        }
+        return ParseInsertRow(statement, values, lengths);
+    }
+
+    cursor += 6;
+    while (true) {
+        while (*cursor == ' ') {
+            cursor++;
+        }
+        if (*cursor != '(') {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        cursor++;
+        for (uint32_t i = 0; i < 3; i++) {
+            char delimiter;
+            if (!ScanValue(&cursor, &values[i], &lengths[i], &delimiter) || delimiter != (i < 2 ? ',' : ')')) {
+                return PREPARE_SYNTAX_ERROR;
+            }
+        }
+        EPrepareResult result = ParseInsertRow(statement, values, lengths);
+        if (result != PREPARE_SUCCESS) {
+            return result;
+        }
+
+        while (*cursor == ' ') {
+            cursor++;
+        }
+        if (*cursor == '\0') {
+            return PREPARE_SUCCESS;
+        }
+        if (*cursor != ',') {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        cursor++;
+    }
+}
+
+// * Parses the column list: nothing or `*` for rows, otherwise a comma
+// * separated list of count(*), min(id) and max(id).
+EPrepareResult ParseProjection(char* projection, Statement* statement) {
+    bool star = false;
+    char* save = NULL;
+
+    for (char* column = strtok_r(projection, ", ", &save); column != NULL; column = strtok_r(NULL, ", ", &save)) {
+        if (strcmp(column, "*") == 0) {
+            star = true;
+            continue;
+        }
+        if (statement->NumAggregates == SELECT_MAX_AGGREGATES) {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        if (strcmp(column, "count(*)") == 0) {
+            statement->Aggregates[statement->NumAggregates++] = AGGREGATE_COUNT;
+        } else if (strcmp(column, "min(id)") == 0) {
+            statement->Aggregates[statement->NumAggregates++] = AGGREGATE_MIN;
+        } else if (strcmp(column, "max(id)") == 0) {
+            statement->Aggregates[statement->NumAggregates++] = AGGREGATE_MAX;
+        } else {
+            return PREPARE_SYNTAX_ERROR;
+        }
+    }
+
+    if (star && statement->NumAggregates > 0) {
+        return PREPARE_SYNTAX_ERROR;
+    }
+    return PREPARE_SUCCESS;
+}
+
+// * select [* | count(*), min(id), max(id)] [where <predicate> [and <predicate>]...]
+// * id = | < | <= | > | >= N
+// * id between A and B
+// * username | email = 'value'
+// * username | email like 'prefix%' | '%suffix' | '%substring%'
+// * Values may be quoted, as in an insert's values list, to hold spaces. Any
+// * value may be a `?` in a prepared statement.
+EPrepareResult PrepareSelect(InputBuffer* inputBuffer, Statement* statement) {
+    statement->Type = STATEMENT_SELECT;
+    statement->KeyFrom = 0;
+    statement->KeyTo = UINT32_MAX;
+    statement->Username.Match = STRING_MATCH_ANY;
+    statement->Email.Match = STRING_MATCH_ANY;
+    statement->NumAggregates = 0;
+
+    char* projection = inputBuffer->Buffer + 6;
+    if (*projection != '\0' && *projection != ' ') {
+        return PREPARE_UNRECOGNIZED_STATEMENT;
+    }
+
+    char* predicates = strstr(projection, " where ");
+    if (predicates != NULL) {
+        *predicates = '\0';
+        predicates += 1;
+    }
+
+    EPrepareResult result = ParseProjection(projection, statement);
+    if (result != PREPARE_SUCCESS || predicates == NULL) {
+        return result;
+    }
+
+    char* cursor = predicates;
+    ScanWord(&cursor); // * where
+    char* column = ScanWord(&cursor);
+    while (column != NULL) {
+        char* operator = ScanWord(&cursor);
+        char* value;
+        uint32_t length;
+        if (operator == NULL || !ScanPredicateValue(&cursor, &value, &length)) {
+            return PREPARE_SYNTAX_ERROR;
+        }
+
+        if (strcmp(column, "id") == 0 && strcmp(operator, "between") == 0) {
+            char* and = ScanWord(&cursor);
+            char* second;
+            uint32_t secondLength;
+            if (and == NULL || strcmp(and, "and") != 0 || !ScanPredicateValue(&cursor, &second, &secondLength)) {
+                return PREPARE_SYNTAX_ERROR;
+            }
+            result = ParseValue(statement, PARAMETER_ID_PREDICATE, 0, ">=", value, length);
+            if (result == PREPARE_SUCCESS) {
+                result = ParseValue(statement, PARAMETER_ID_PREDICATE, 0, "<=", second, secondLength);
+            }
+        } else if (strcmp(column, "id") == 0) {
+            result = ParseValue(statement, PARAMETER_ID_PREDICATE, 0, operator, value, length);
+        } else if (strcmp(column, "username") == 0) {
+            result = ParseValue(statement, PARAMETER_USERNAME_PREDICATE, 0, operator, value, length);
+        } else if (strcmp(column, "email") == 0) {
+            result = ParseValue(statement, PARAMETER_EMAIL_PREDICATE, 0, operator, value, length);
+        } else {
+            result = PREPARE_SYNTAX_ERROR;
+        }
+        if (result != PREPARE_SUCCESS) {
+            return result;
+        }
+
+        char* and = ScanWord(&cursor);
+        if (and == NULL) {
+            break;
+        }
+        if (strcmp(and, "and") != 0) {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        column = ScanWord(&cursor);
+        if (column == NULL) {
+            return PREPARE_SYNTAX_ERROR;
+        }
+    }
+    if (column == NULL) {
+        return PREPARE_SYNTAX_ERROR; // * `where` with nothing after it
+    }
+    return PREPARE_SUCCESS;
+}
+
+// * create index on username | email
+EPrepareResult PrepareCreateIndex(InputBuffer* inputBuffer, Statement* statement) {
+    statement->Type = STATEMENT_CREATE_INDEX;
+    if (strcmp(inputBuffer->Buffer, "create index on username") == 0) {
+        statement->IndexColumn = INDEX_USERNAME;
+    } else if (strcmp(inputBuffer->Buffer, "create index on email") == 0) {
+        statement->IndexColumn = INDEX_EMAIL;
+    } else {
+        return PREPARE_SYNTAX_ERROR;
+    }
+    return PREPARE_SUCCESS;
+}
+
+EPrepareResult ParseStatement(InputBuffer* inputBuffer, Statement* statement) {
+    statement->NumParameters = 0;
+    statement->NumRows = 0;
+
+    if (strncmp(inputBuffer->Buffer, "insert", 6) == 0) { // NOLINT
+        return PrepareInsert(inputBuffer, statement);
+    } else if (strncmp(inputBuffer->Buffer, "select", 6) == 0) { // NOLINT
+        return PrepareSelect(inputBuffer, statement);
+    } else if (strncmp(inputBuffer->Buffer, "create ", 7) == 0) { // NOLINT
+        return PrepareCreateIndex(inputBuffer, statement);
+    }
+    return PREPARE_UNRECOGNIZED_STATEMENT;
+}
+
+EPrepareResult PrepareStatement(InputBuffer* inputBuffer, Statement* statement) {
+    uint64_t startedAt = StatsNow();
+    EPrepareResult result = ParseStatement(inputBuffer, statement);
+    if (result == PREPARE_SUCCESS && statement->NumParameters > 0) {
+        result = PREPARE_PARAMETER_COUNT; // * `?` only makes sense in `.prepare`
+    }
+    StatsRecord(STATS_PREPARE_STATEMENT, startedAt);
+    return result;
+}
+
+PreparedStatements* NewPreparedStatements() {
+    PreparedStatements* prepared = malloc(sizeof(PreparedStatements));
+    prepared->Statements = NULL;
+    prepared->NumStatements = 0;
+    return prepared;
+}
+
+PreparedStatement* FindPrepared(PreparedStatements* prepared, const char* name, size_t nameLength) {
+    for (uint32_t i = 0; i < prepared->NumStatements; i++) {
+        PreparedStatement* candidate = &prepared->Statements[i];
+        if (strlen(candidate->Name) == nameLength && memcmp(candidate->Name, name, nameLength) == 0) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+// * `.prepare NAME STATEMENT` parses the statement once and keeps the plan
+// * under the name, replacing any plan it had
+EPrepareResult PrepareNamed(PreparedStatements* prepared, const char* text) {
+    size_t nameLength = strcspn(text, " ");
+    const char* body = text + nameLength;
+    while (*body == ' ') {
+        body++;
+    }
+    if (nameLength == 0 || *body == '\0') {
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    InputBuffer inputBuffer;
+    inputBuffer.Buffer = strdup(body);
+    inputBuffer.InputLength = strlen(body);
+    inputBuffer.BufferLength = inputBuffer.InputLength + 1;
+    Statement* plan = malloc(sizeof(Statement));
+    EPrepareResult result = ParseStatement(&inputBuffer, plan);
+    if (result != PREPARE_SUCCESS) {
+        free(inputBuffer.Buffer);
+        free(plan);
+        return result;
+    }
+
+    PreparedStatement* statement = FindPrepared(prepared, text, nameLength);
+    if (statement != NULL) {
+        free(statement->Text);
+        free(statement->Plan);
+    } else {
+        prepared->Statements = realloc(prepared->Statements, (prepared->NumStatements + 1) * sizeof(PreparedStatement));
+        statement = &prepared->Statements[prepared->NumStatements++];
+        statement->Name = strndup(text, nameLength);
+    }
+    statement->Text = inputBuffer.Buffer;
+    statement->Plan = plan;
+    return PREPARE_SUCCESS;
+}
+
+// * `.exec NAME VALUE...` copies the named plan into statement and fills its
+// * parameters in order from the values, which are separated by spaces or
+// * commas and may be quoted. Nothing is parsed but the values, which stay
+// * in the arguments' buffer.
+EPrepareResult BindPrepared(PreparedStatements* prepared, char* arguments, Statement* statement) {
+    uint64_t startedAt = StatsNow();
+    size_t nameLength = strcspn(arguments, " ");
+    PreparedStatement* named = FindPrepared(prepared, arguments, nameLength);
+    if (named == NULL) {
+        StatsRecord(STATS_PREPARE_STATEMENT, startedAt);
+        return PREPARE_UNKNOWN_NAME;
+    }
+
+    Statement* plan = named->Plan;
+    memcpy(statement, plan, offsetof(Statement, Rows) + plan->NumRows * sizeof(RowFields));
+    char* cursor = arguments + nameLength;
+    EPrepareResult result = PREPARE_SUCCESS;
+    for (uint32_t i = 0; i < plan->NumParameters && result == PREPARE_SUCCESS; i++) {
+        while (*cursor == ' ') {
+            cursor++;
+        }
+        char* value;
+        uint32_t length;
+        char delimiter;
+        if (*cursor == '\0') {
+            result = PREPARE_PARAMETER_COUNT;
+        } else if (!ScanValue(&cursor, &value, &length, &delimiter) || delimiter == '(' || delimiter == ')') {
+            result = PREPARE_SYNTAX_ERROR;
+        } else {
+            result = SetParameter(statement, &plan->Parameters[i], value, length);
+        }
+    }
+    while (*cursor == ' ') {
+        cursor++;
+    }
+    if (result == PREPARE_SUCCESS && *cursor != '\0') {
+        result = PREPARE_PARAMETER_COUNT;
+    }
+
+    StatsRecord(STATS_PREPARE_STATEMENT, startedAt);
+    return result;
+}
+
+void ClosePreparedStatements(PreparedStatements* prepared) {
+    for (uint32_t i = 0; i < prepared->NumStatements; i++) {
+        free(prepared->Statements[i].Name);
+        free(prepared->Statements[i].Text);
+        free(prepared->Statements[i].Plan);
+    }
+    free(prepared->Statements);
+    free(prepared);
+}
+
+// * Sorts an insert's rows by ID. Rows with equal IDs keep the order they
+// * were listed in, so the first of them is the one inserted.
+void SortInsertRows(Statement* statement) {
+    RowFields* rows = statement->Rows;
+    for (uint32_t i = 1; i < statement->NumRows; i++) {
+        RowFields row = rows[i];
+        uint32_t j = i;
+        for (; j > 0 && rows[j - 1].ID > row.ID; j--) {
+            rows[j] = rows[j - 1];
+        }
+        rows[j] = row;
+    }
+}
+
+// * Rows go in in ID order a leaf at a time. Each row stands alone: one whose
+// * ID is taken is skipped and the statement reports a duplicate key once the
+// * others are in. The statement commits once, after its last row, so a crash
+// * leaves all of its rows or none; a list that dirties more pages than the
+// * buffer pool holds spills some of them to the log.
+EExecuteResult ExecuteInsert(Statement* statement, Table* table) {
+    SortInsertRows(statement);
+    RowFields* rows = statement->Rows;
+    bool inserted[INSERT_MAX_ROWS];
+    EExecuteResult result = EXECUTE_SUCCESS;
+
+    pthread_mutex_lock(&table->WriteLock);
+    uint32_t i = 0;
+    while (i < statement->NumRows && result != EXECUTE_TABLE_FULL) {
+        uint32_t numConsumed;
+        EExecuteResult runResult = TableInsert(table, rows + i, statement->NumRows - i, inserted + i, &numConsumed);
+        if (runResult != EXECUTE_SUCCESS) {
+            result = runResult;
+        }
+        for (uint32_t end = i + numConsumed; i < end; i++) {
+            if (inserted[i]) {
+                IndexInsertRow(table, rows[i].ID, rows[i].Username, rows[i].UsernameLength, rows[i].Email, rows[i].EmailLength);
+            }
+        }
+    }
+    CommitPager(table->Pager);
+    pthread_mutex_unlock(&table->WriteLock);
+    return result;
+}
+
+bool MatchString(const StringPredicate* predicate, const char* value, uint32_t length) {
+    uint32_t patternLength = predicate->PatternLength;
+    switch (predicate->Match) {
+    case (STRING_MATCH_ANY):
+        return true;
+    case (STRING_MATCH_EQUAL):
+        return length == patternLength && memcmp(value, predicate->Pattern, patternLength) == 0;
+    case (STRING_MATCH_PREFIX):
+        return length >= patternLength && memcmp(value, predicate->Pattern, patternLength) == 0;
+    case (STRING_MATCH_SUFFIX):
+        return length >= patternLength && memcmp(value + length - patternLength, predicate->Pattern, patternLength) == 0;
+    case (STRING_MATCH_CONTAINS):
+        return memmem(value, length, predicate->Pattern, patternLength) != NULL;
+    }
+    return false;
+}
+
+// * Filters cells [from, to) of a leaf on the string predicates, writing the
+// * indices that pass to selection in key order. Cells are matched where they
+// * lie in the page; nothing is copied out. Returns the number selected.
+uint32_t ScanLeafBatch(void* node, uint32_t from, uint32_t to, Statement* statement, uint16_t* selection) {
+    uint32_t numSelected = 0;
+    for (uint32_t i = from; i < to; i++) {
+        const char *username, *email;
+        uint32_t usernameLength, emailLength;
+        CellFields(LeafNodeValue(node, i), &username, &usernameLength, &email, &emailLength);
+        // * Written unconditionally and kept only on a match, so the loop has no data-dependent store
+        selection[numSelected] = i;
+        numSelected += MatchString(&statement->Username, username, usernameLength) && MatchString(&statement->Email, email, emailLength);
+    }
+    return numSelected;
+}
+
+// * CSV output starts every result with a header line
+void SinkBeginResult(ResultSink* sink, Statement* statement) {
+    if (sink->Mode != OUTPUT_MODE_CSV) {
+        return;
+    }
+    if (statement->NumAggregates == 0) {
+        SinkWrite(sink, "id,username,email\n", 18);
+        return;
+    }
+    for (uint32_t i = 0; i < statement->NumAggregates; i++) {
+        if (i > 0) {
+            SinkWrite(sink, ",", 1);
+        }
+        switch (statement->Aggregates[i]) {
+        case (AGGREGATE_COUNT):
+            SinkWrite(sink, "count", 5);
+            break;
+        case (AGGREGATE_MIN):
+            SinkWrite(sink, "min", 3);
+            break;
+        case (AGGREGATE_MAX):
+            SinkWrite(sink, "max", 3);
+            break;
+        }
+    }
+    SinkWrite(sink, "\n", 1);
+}
+
+// * Writes the aggregate values of a select as one result row. A min or max
+// * over no rows is NULL in text, empty in CSV and UINT64_MAX in binary.
+void SinkAggregates(ResultSink* sink, Statement* statement, uint64_t count, uint32_t minKey, uint32_t maxKey) {
+    if (sink->Mode == OUTPUT_MODE_BINARY) {
+        uint16_t recordLength = statement->NumAggregates * sizeof(uint64_t);
+        SinkWrite(sink, &recordLength, sizeof(recordLength));
+    }
+
+    for (uint32_t i = 0; i < statement->NumAggregates; i++) {
+        bool null = statement->Aggregates[i] != AGGREGATE_COUNT && count == 0;
+        uint64_t value = statement->Aggregates[i] == AGGREGATE_COUNT ? count : statement->Aggregates[i] == AGGREGATE_MIN ? minKey : maxKey;
+
+        switch (sink->Mode) {
+        case (OUTPUT_MODE_TEXT):
+            if (i > 0) {
+                SinkWrite(sink, ", ", 2);
+            }
+            null ? SinkWrite(sink, "NULL", 4) : SinkUnsigned(sink, value);
+            break;
+        case (OUTPUT_MODE_CSV):
+            if (i > 0) {
+                SinkWrite(sink, ",", 1);
+            }
+            if (!null) {
+                SinkUnsigned(sink, value);
+            }
+            break;
+        case (OUTPUT_MODE_BINARY):
+            value = null ? UINT64_MAX : value;
+            SinkWrite(sink, &value, sizeof(value));
+            break;
+        }
+    }
+
+    if (sink->Mode != OUTPUT_MODE_BINARY) {
+        SinkWrite(sink, "\n", 1);
+    }
+}
+
+// * Scans keys [keyFrom, keyTo] a leaf at a time. Keys are sorted within a
+// * leaf, so id predicates reduce to the bounds of the range on each page;
+// * string predicates run over the whole batch before any row is printed.
+// * Aggregates with no string predicate only read the slot directory. Rows
+// * stream into the sink page by page, so memory use does not grow with the
+// * result; an aggregate select folds them into aggregate instead.
+void ScanRange(Statement* statement, Table* table, uint32_t keyFrom, uint32_t keyTo, ResultSink* sink, ScanAggregate* aggregate) {
+    bool filtered = statement->Username.Match != STRING_MATCH_ANY || statement->Email.Match != STRING_MATCH_ANY;
+    bool aggregating = statement->NumAggregates > 0;
+    uint16_t selection[LEAF_NODE_MAX_CELLS];
+    Cursor* cursor = TableFind(table, keyFrom);
+
+    while (!(cursor->EndOfTable)) {
+        void* node = cursor->Page;
+        uint32_t numCells = *LeafNodeNumCells(node);
+        uint32_t from = cursor->CellNum;
+        uint32_t to = keyTo == UINT32_MAX ? numCells : LeafNodeFindCell(node, keyTo + 1);
+
+        if (!filtered && aggregating && from < to) {
+            if (aggregate->Count == 0) {
+                aggregate->MinKey = *LeafNodeKey(node, from);
+            }
+            aggregate->Count += to - from;
+            aggregate->MaxKey = *LeafNodeKey(node, to - 1);
+        } else if (!filtered) {
+            for (uint32_t i = from; i < to; i++) {
+                SinkRow(sink, *LeafNodeKey(node, i), LeafNodeValue(node, i));
+            }
+        } else {
+            uint32_t numSelected = ScanLeafBatch(node, from, to, statement, selection);
+            if (aggregating && numSelected > 0) {
+                if (aggregate->Count == 0) {
+                    aggregate->MinKey = *LeafNodeKey(node, selection[0]);
+                }
+                aggregate->Count += numSelected;
+                aggregate->MaxKey = *LeafNodeKey(node, selection[numSelected - 1]);
+            } else if (!aggregating) {
+                for (uint32_t i = 0; i < numSelected; i++) {
+                    SinkRow(sink, *LeafNodeKey(node, selection[i]), LeafNodeValue(node, selection[i]));
+                }
+            }
+        }
+
+        if (to < numCells) {
+            break; // * past keyTo
+        }
+        cursor->CellNum = numCells;
+        CursorSkipExhaustedLeaves(cursor);
+    }
+
+    CloseCursor(cursor);
+}
+
+// * Answers a select with an equality predicate on an indexed column by
+// * fetching just the rows the index names, in key order, and applying every
+// * predicate to each. Returns false, having read nothing, if neither string
+// * predicate is an equality on an indexed column.
+bool IndexSelect(Statement* statement, Table* table, ResultSink* sink, ScanAggregate* aggregate) {
+    uint32_t* keys;
+    uint32_t numKeys;
+    bool indexed = false;
+    if (statement->Email.Match == STRING_MATCH_EQUAL) {
+        indexed = IndexLookup(table, INDEX_EMAIL, statement->Email.Pattern, statement->Email.PatternLength, statement->KeyFrom, statement->KeyTo, &keys, &numKeys);
+    }
+    if (!indexed && statement->Username.Match == STRING_MATCH_EQUAL) {
+        indexed = IndexLookup(table, INDEX_USERNAME, statement->Username.Pattern, statement->Username.PatternLength, statement->KeyFrom, statement->KeyTo, &keys, &numKeys);
+    }
+    if (!indexed) {
+        return false;
+    }
+
+    uint16_t selection[1];
+    for (uint32_t i = 0; i < numKeys; i++) {
+        Cursor* cursor = TableFind(table, keys[i]);
+        if (cursor->EndOfTable || CursorKey(cursor) != keys[i] || ScanLeafBatch(cursor->Page, cursor->CellNum, cursor->CellNum + 1, statement, selection) == 0) {
+            CloseCursor(cursor);
+            continue;
+        }
+        if (statement->NumAggregates > 0) {
+            if (aggregate->Count == 0) {
+                aggregate->MinKey = keys[i];
+            }
+            aggregate->Count += 1;
+            aggregate->MaxKey = keys[i];
+        } else {
+            SinkRow(sink, keys[i], CursorValue(cursor));
+        }
+        CloseCursor(cursor);
+    }
+    free(keys);
+    return true;
+}
+
+// * A bare count(*) of the whole table is answered from the row count without
+// * reading the tree. Equality lookups on an indexed column go through the index. Large ranges
+// * are split across the scan threads; ParallelSelect declines the rest, which
+// * run here on the calling thread.
+EExecuteResult ExecuteSelect(Statement* statement, Table* table, ResultSink* sink) {
+    fflush(stdout); // * keep the prompt ahead of rows written through the sink
+    SinkBeginResult(sink, statement);
+
+    ScanAggregate aggregate;
+    memset(&aggregate, 0, sizeof(aggregate));
+    bool fullScan = statement->KeyFrom == 0 && statement->KeyTo == UINT32_MAX;
+    bool filtered = statement->Username.Match != STRING_MATCH_ANY || statement->Email.Match != STRING_MATCH_ANY;
+    if (fullScan && !filtered && statement->NumAggregates == 1 && statement->Aggregates[0] == AGGREGATE_COUNT) {
+        // * The file header keeps the table's row count
+        aggregate.Count = __atomic_load_n(&table->NumRows, __ATOMIC_RELAXED);
+    } else if (statement->KeyFrom <= statement->KeyTo && !IndexSelect(statement, table, sink, &aggregate)) {
+        PagerAdvise(table->Pager, fullScan ? PAGER_ACCESS_SEQUENTIAL : PAGER_ACCESS_RANDOM);
+        if (!ParallelSelect(statement, table, sink, &aggregate)) {
+            ScanRange(statement, table, statement->KeyFrom, statement->KeyTo, sink, &aggregate);
+        }
+    }
+
+    if (statement->NumAggregates > 0) {
+        SinkAggregates(sink, statement, aggregate.Count, aggregate.MinKey, aggregate.MaxKey);
+    }
+    SinkFlush(sink);
+    return EXECUTE_SUCCESS;
+}
+
+EExecuteResult ExecuteStatement(Statement* statement, Table* table, ResultSink* output) {
+    uint64_t startedAt = StatsNow();
+    EExecuteResult result = EXECUTE_SUCCESS;
+
+    switch (statement->Type) {
+    case (STATEMENT_INSERT):
+        // printf("This is where we would do an insert.\n");
+        result = ExecuteInsert(statement, table);
+        StatsRecord(STATS_EXECUTE_INSERT, startedAt);
+        break;
+    case (STATEMENT_SELECT):
+        // printf("This is where we would do a select.\n");
+        result = ExecuteSelect(statement, table, output);
+        StatsRecord(STATS_EXECUTE_SELECT, startedAt);
+        break;
+    case (STATEMENT_CREATE_INDEX):
+        result = CreateIndex(table, statement->IndexColumn);
+        StatsRecord(STATS_CREATE_INDEX, startedAt);
+        break;
+    }
+    return result;
+}
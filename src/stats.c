@@ -0,0 +1,114 @@
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+
+EngineStats Stats;
+
+const char* const STATS_TIMER_NAMES[STATS_NUM_TIMERS] = {
+    "get_page_miss",
+    "read_ahead",
+    "read_ahead_wait",
+    "flush_page",
+    "wal_write",
+    "wal_sync",
+    "prepare_statement",
+    "execute_insert",
+    "execute_select",
+    "create_index",
+};
+
+uint64_t StatsNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// * Sessions on the server record concurrently, so every update is atomic.
+// * Counters in EngineStats are only written under the pager's locks.
+void StatsRecord(EStatsTimer timer, uint64_t startedAt) {
+    uint64_t elapsed = StatsNow() - startedAt;
+    LatencyHistogram* histogram = &Stats.Timers[timer];
+
+    uint32_t bucket = 63 - __builtin_clzll(elapsed | 1);
+    if (bucket >= STATS_HISTOGRAM_BUCKETS) {
+        bucket = STATS_HISTOGRAM_BUCKETS - 1;
+    }
+    __atomic_fetch_add(&histogram->Buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->Count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->TotalNs, elapsed, __ATOMIC_RELAXED);
+    uint64_t maxNs = __atomic_load_n(&histogram->MaxNs, __ATOMIC_RELAXED);
+    while (elapsed > maxNs && !__atomic_compare_exchange_n(&histogram->MaxNs, &maxNs, elapsed, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void ResetStats() {
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+// * Upper bound of the bucket holding the percentile, capped at the maximum
+double HistogramPercentileUs(LatencyHistogram* histogram, uint32_t percent) {
+    if (histogram->Count == 0) {
+        return 0;
+    }
+    uint64_t rank = (histogram->Count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->Buckets[i];
+        if (seen >= rank) {
+            uint64_t upperNs = (uint64_t)2 << i;
+            return (upperNs < histogram->MaxNs ? upperNs : histogram->MaxNs) / 1000.0;
+        }
+    }
+    return histogram->MaxNs / 1000.0;
+}
+
+// * Time spent waiting on the file and the log, against time spent in statements
+void StatsSplit(double* ioMs, double* statementMs) {
+    *ioMs = (Stats.Timers[STATS_GET_PAGE_MISS].TotalNs + Stats.Timers[STATS_READ_AHEAD_WAIT].TotalNs + Stats.Timers[STATS_FLUSH_PAGE].TotalNs + Stats.Timers[STATS_WAL_WRITE].TotalNs + Stats.Timers[STATS_WAL_SYNC].TotalNs) / 1e6;
+    *statementMs = (Stats.Timers[STATS_PREPARE_STATEMENT].TotalNs + Stats.Timers[STATS_EXECUTE_INSERT].TotalNs + Stats.Timers[STATS_EXECUTE_SELECT].TotalNs + Stats.Timers[STATS_CREATE_INDEX].TotalNs) / 1e6;
+}
+
+void PrintStats() {
+    uint64_t hits = Stats.PageRequests - Stats.PageMisses;
+    printf("Pages: %llu requests, %llu hits (%.1f%%), %llu misses, %llu prefetched, %llu bytes read\n",
+           (unsigned long long)Stats.PageRequests, (unsigned long long)hits,
+           Stats.PageRequests > 0 ? 100.0 * hits / Stats.PageRequests : 0.0,
+           (unsigned long long)Stats.PageMisses, (unsigned long long)Stats.PagesPrefetched, (unsigned long long)Stats.BytesRead);
+    printf("Flushes: %llu pages, %llu bytes\n", (unsigned long long)Stats.PagesFlushed, (unsigned long long)Stats.BytesFlushed);
+    printf("Log: %llu bytes written, %llu syncs, %llu pages spilled\n", (unsigned long long)Stats.WalBytesWritten, (unsigned long long)Stats.WalSyncs, (unsigned long long)Stats.PagesSpilled);
+
+    printf("%-18s %10s %10s %10s %10s %10s %10s\n", "latency", "count", "avg us", "p50 us", "p99 us", "max us", "total ms");
+    for (uint32_t i = 0; i < STATS_NUM_TIMERS; i++) {
+        LatencyHistogram* histogram = &Stats.Timers[i];
+        printf("%-18s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", STATS_TIMER_NAMES[i], (unsigned long long)histogram->Count,
+               histogram->Count > 0 ? histogram->TotalNs / 1000.0 / histogram->Count : 0.0,
+               HistogramPercentileUs(histogram, 50), HistogramPercentileUs(histogram, 99),
+               histogram->MaxNs / 1000.0, histogram->TotalNs / 1e6);
+    }
+
+    double ioMs, statementMs;
+    StatsSplit(&ioMs, &statementMs);
+    printf("Time: %.2f ms waiting on I/O, %.2f ms in statements\n", ioMs, statementMs);
+}
+
+void PrintStatsJson(FILE* stream) {
+    fprintf(stream, "{\"page_requests\": %llu, \"page_misses\": %llu, \"pages_prefetched\": %llu, \"bytes_read\": %llu, ",
+            (unsigned long long)Stats.PageRequests, (unsigned long long)Stats.PageMisses,
+            (unsigned long long)Stats.PagesPrefetched, (unsigned long long)Stats.BytesRead);
+    fprintf(stream, "\"pages_flushed\": %llu, \"bytes_flushed\": %llu, \"wal_bytes_written\": %llu, \"wal_syncs\": %llu, \"pages_spilled\": %llu, ",
+            (unsigned long long)Stats.PagesFlushed, (unsigned long long)Stats.BytesFlushed,
+            (unsigned long long)Stats.WalBytesWritten, (unsigned long long)Stats.WalSyncs, (unsigned long long)Stats.PagesSpilled);
+
+    fprintf(stream, "\"latency\": {");
+    for (uint32_t i = 0; i < STATS_NUM_TIMERS; i++) {
+        LatencyHistogram* histogram = &Stats.Timers[i];
+        fprintf(stream, "%s\"%s\": {\"count\": %llu, \"total_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f}",
+                i > 0 ? ", " : "", STATS_TIMER_NAMES[i], (unsigned long long)histogram->Count, histogram->TotalNs / 1000.0,
+                HistogramPercentileUs(histogram, 50), HistogramPercentileUs(histogram, 99), histogram->MaxNs / 1000.0);
+    }
+
+    double ioMs, statementMs;
+    StatsSplit(&ioMs, &statementMs);
+    fprintf(stream, "}, \"io_ms\": %.3f, \"statement_ms\": %.3f}\n", ioMs, statementMs);
+}